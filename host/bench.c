@@ -0,0 +1,1084 @@
+// Event-replay benchmark for the watchface.
+//
+// Builds the real src/c/modulus.c against the stub SDK in this directory and
+// replays a scripted timeline through it: minute ticks, battery events,
+// health samples and AppMessage traffic from a scripted phone. Reports how
+// often each handler and update proc ran, what they cost in wall time, and
+// how many expensive SDK calls (radial fills, dirty marks, flash writes) they
+// made. Run `make bench` to build every platform and replay every scenario.
+//
+// The frames scenario also rasterizes what the face draws, compares named
+// frames against the PNGs in golden/<platform>/ and reports how many pixels
+// each update proc writes against how many it needed to; see `make golden`.
+#define main modulus_main
+#include "../src/c/modulus.c"
+#undef main
+
+#include "raster.h"
+#include "stub.h"
+
+#include <errno.h>
+#include <libgen.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+typedef struct
+{
+  const char *name;
+  const char *description;
+  // Returns false if a check failed; the report says which.
+  bool (*run)(void);
+  bool legacy_storage;
+  bool rasterize;
+} Scenario;
+
+// 2026-03-02 00:00:00 UTC, a Monday.
+static const time_t TIMELINE_START = 1772409600;
+
+static uint32_t s_rand_state = 12345;
+
+static uint32_t bench_rand(void)
+{
+  s_rand_state = s_rand_state * 1103515245u + 12345u;
+  return (s_rand_state >> 16) & 0x7fff;
+}
+
+static uint64_t bench_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Phone
+
+typedef enum
+{
+  PhoneOnline,
+  PhoneNoNetwork,
+  PhoneDisconnected,
+} PhoneLink;
+
+static PhoneLink s_phone_link = PhoneOnline;
+static int32_t s_phone_temperature = 12;
+static int32_t s_phone_conditions = 1;
+static bool s_phone_sends_forecast;
+
+// The weather the day timeline follows: cool at night, warmest at 14:00.
+static void phone_day_weather(int hour, int32_t *temperature, int32_t *conditions)
+{
+  *temperature = 4 + (hour < 14 ? hour : 28 - hour) / 2;
+  *conditions = (hour / 6) % 6;
+}
+
+static void phone_set_link(PhoneLink link)
+{
+  s_phone_link = link;
+  stub_set_connected(link != PhoneDisconnected);
+}
+
+static uint16_t phone_weather_message(uint8_t *buffer, uint16_t size)
+{
+  static const char location[] = "Kitchener";
+  uint8_t payload[WEATHER_PAYLOAD_HEADER_SIZE + sizeof(location) - 1] = {
+      WEATHER_PAYLOAD_VERSION,
+      s_phone_temperature & 0xff, (s_phone_temperature >> 8) & 0xff,
+      18, 0,
+      4, 0,
+      s_phone_conditions,
+      sizeof(location) - 1,
+  };
+  memcpy(&payload[WEATHER_PAYLOAD_HEADER_SIZE], location, sizeof(location) - 1);
+
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, size);
+  dict_write_data(&iter, MESSAGE_KEY_WEATHER, payload, sizeof(payload));
+  if (s_phone_sends_forecast)
+  {
+    const uint32_t start = stub_now() / 3600 * 3600;
+    uint8_t forecast[FORECAST_PAYLOAD_HEADER_SIZE + FORECAST_HOURS * 2] = {
+        FORECAST_PAYLOAD_VERSION,
+        start & 0xff, (start >> 8) & 0xff, (start >> 16) & 0xff, start >> 24,
+        FORECAST_HOURS,
+    };
+    for (int i = 0; i < FORECAST_HOURS; i++)
+    {
+      int32_t temperature, conditions;
+      phone_day_weather((start / 3600 + i) % 24, &temperature, &conditions);
+      forecast[FORECAST_PAYLOAD_HEADER_SIZE + 2 * i] = (uint8_t)temperature;
+      forecast[FORECAST_PAYLOAD_HEADER_SIZE + 2 * i + 1] = conditions;
+    }
+    dict_write_data(&iter, MESSAGE_KEY_FORECAST, forecast, sizeof(forecast));
+  }
+  return dict_write_end(&iter);
+}
+
+// The watch's settings as the pkjs side last saw them acknowledged; like
+// SettingsSync.save() in src/pkjs/settings.js, a save only sends what
+// changed and the phone-only weather settings never go to the watch.
+// Returns 0 when there is nothing to send.
+static int32_t s_phone_acked_accent = -1;
+
+static uint16_t phone_config_message(uint8_t *buffer, uint16_t size, int32_t accent)
+{
+  if (accent == s_phone_acked_accent)
+  {
+    return 0;
+  }
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, size);
+  if (s_phone_acked_accent < 0)
+  {
+    dict_write_int32(&iter, MESSAGE_KEY_UPDATE_INTERVAL, 30);
+    dict_write_int32(&iter, MESSAGE_KEY_STEP_GOAL, 8000);
+    dict_write_int32(&iter, MESSAGE_KEY_MOVE_GOAL, 45);
+    dict_write_int32(&iter, MESSAGE_KEY_CAL_GOAL, 400);
+    dict_write_int32(&iter, MESSAGE_KEY_BACKGROUND_COLOUR, 0x000000);
+    dict_write_int32(&iter, MESSAGE_KEY_HEALTH_OUTER_ARC_COLOUR, 0x55FFAA);
+    dict_write_int32(&iter, MESSAGE_KEY_HEALTH_MIDDLE_ARC_COLOUR, 0x55AAFF);
+    dict_write_int32(&iter, MESSAGE_KEY_HEALTH_INNER_ARC_COLOUR, 0xFFAA55);
+  }
+  dict_write_int32(&iter, MESSAGE_KEY_ACCENT_COLOUR, accent);
+  s_phone_acked_accent = accent;
+  return dict_write_end(&iter);
+}
+
+// The last PERF payload the watch sent, as the pkjs side would log it.
+static uint8_t s_phone_perf[PERF_PAYLOAD_SIZE];
+static uint16_t s_phone_perf_length;
+
+// Answers whatever the watch has in flight, like the pkjs side does.
+static void phone_service_outbox(void)
+{
+  uint8_t request[256];
+  uint16_t request_size = stub_phone_take_outbox(request, sizeof(request));
+  if (!request_size)
+  {
+    return;
+  }
+  if (s_phone_link == PhoneDisconnected)
+  {
+    stub_phone_ack_outbox(APP_MSG_NOT_CONNECTED);
+    return;
+  }
+  stub_phone_ack_outbox(APP_MSG_OK);
+
+  DictionaryIterator iter;
+  dict_read_begin_from_buffer(&iter, request, request_size);
+  const Tuple *perf = dict_find(&iter, MESSAGE_KEY_PERF);
+  if (perf)
+  {
+    s_phone_perf_length = perf->length < sizeof(s_phone_perf) ? perf->length : sizeof(s_phone_perf);
+    memcpy(s_phone_perf, perf->value->data, s_phone_perf_length);
+    return;
+  }
+  if (s_phone_link == PhoneNoNetwork)
+  {
+    return;
+  }
+
+  uint8_t reply[256];
+  stub_deliver_inbox(reply, phone_weather_message(reply, sizeof(reply)));
+}
+
+// Saved places as packPlaces() in src/pkjs/index.js sends them, each read
+// at read_at and forecast hour by hour from the next hour on.
+static const char *const PHONE_PLACES[] = {"Home", "Work", "Cottage"};
+#define PHONE_PLACE_COUNT (int)(sizeof(PHONE_PLACES) / sizeof(PHONE_PLACES[0]))
+
+static void put_uint32_le(uint8_t *bytes, uint32_t value)
+{
+  bytes[0] = value & 0xff;
+  bytes[1] = (value >> 8) & 0xff;
+  bytes[2] = (value >> 16) & 0xff;
+  bytes[3] = value >> 24;
+}
+
+static int32_t phone_place_temperature(int place, int hour)
+{
+  return 6 + 5 * place + hour;
+}
+
+static uint16_t phone_places_message(uint8_t *buffer, uint16_t size, time_t read_at)
+{
+  uint8_t payload[2 + PLACES_MAX * (13 + 2 * PLACE_FORECAST_HOURS + PLACE_NAME_SIZE)];
+  size_t length = 0;
+  payload[length++] = PLACES_PAYLOAD_VERSION;
+  payload[length++] = PHONE_PLACE_COUNT;
+  for (int place = 0; place < PHONE_PLACE_COUNT; place++)
+  {
+    put_uint32_le(&payload[length], read_at);
+    payload[length + 4] = phone_place_temperature(place, 0);
+    payload[length + 5] = phone_place_temperature(place, 0) + 6;
+    payload[length + 6] = phone_place_temperature(place, 0) - 4;
+    payload[length + 7] = place;
+    put_uint32_le(&payload[length + 8], (read_at / 3600 + 1) * 3600);
+    payload[length + 12] = PLACE_FORECAST_HOURS;
+    length += 13;
+    for (int hour = 1; hour <= PLACE_FORECAST_HOURS; hour++)
+    {
+      payload[length++] = phone_place_temperature(place, hour);
+      payload[length++] = (place + hour) % 6;
+    }
+    payload[length++] = strlen(PHONE_PLACES[place]);
+    memcpy(&payload[length], PHONE_PLACES[place], strlen(PHONE_PLACES[place]));
+    length += strlen(PHONE_PLACES[place]);
+  }
+
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, size);
+  dict_write_data(&iter, MESSAGE_KEY_PLACES, payload, length);
+  return dict_write_end(&iter);
+}
+
+// Seeds storage with what a configured watch had under the per-key layout
+// used up to 1.27.
+static void seed_configured_watch(void)
+{
+  persist_write_int(MESSAGE_KEY_UPDATE_INTERVAL, 30);
+  persist_write_int(MESSAGE_KEY_BACKGROUND_COLOUR, 0x000000);
+  persist_write_int(MESSAGE_KEY_ACCENT_COLOUR, 0x55FFAA);
+  persist_write_int(MESSAGE_KEY_HEALTH_OUTER_ARC_COLOUR, 0x55FFAA);
+  persist_write_int(MESSAGE_KEY_HEALTH_MIDDLE_ARC_COLOUR, 0x55AAFF);
+  persist_write_int(MESSAGE_KEY_HEALTH_INNER_ARC_COLOUR, 0xFFAA55);
+  persist_write_int(MESSAGE_KEY_STEP_GOAL, 8000);
+  persist_write_int(MESSAGE_KEY_MOVE_GOAL, 45);
+  persist_write_int(MESSAGE_KEY_CAL_GOAL, 400);
+  persist_write_int(MESSAGE_KEY_CONDITIONS, 1);
+  persist_write_string(MESSAGE_KEY_LOCATION_NAME, "Kitchener");
+  persist_write_int(MESSAGE_KEY_CUR_TEMP, 12);
+  persist_write_int(MESSAGE_KEY_LOW_TEMP, 4);
+  persist_write_int(MESSAGE_KEY_HIGH_TEMP, 18);
+}
+
+// Scenarios
+
+static bool run_cold_start(void)
+{
+  return true;
+}
+
+// Most minute history records a single tick has read.
+static uint32_t s_max_tick_minute_records;
+
+// Fires the tick for the minute the clock is in.
+static struct tm fire_minute_tick(void)
+{
+  struct tm now = *localtime(&(time_t){stub_now()});
+  TimeUnits units = MINUTE_UNIT;
+  if (now.tm_min == 0)
+  {
+    units |= HOUR_UNIT;
+    if (now.tm_hour == 0)
+    {
+      units |= DAY_UNIT;
+    }
+  }
+  const uint32_t read = stub_counters.health_minute_records;
+  stub_fire_tick(units);
+  if (stub_counters.health_minute_records - read > s_max_tick_minute_records)
+  {
+    s_max_tick_minute_records = stub_counters.health_minute_records - read;
+  }
+  return now;
+}
+
+// Advances the clock to the given minute of the timeline and fires the
+// minute tick, then lets the phone answer whatever the watch sent.
+static struct tm tick_minute(int minute)
+{
+  stub_set_time(TIMELINE_START + minute * 60);
+  const struct tm now = fire_minute_tick();
+  phone_service_outbox();
+  return now;
+}
+
+static bool run_day(void)
+{
+  BatteryChargeState battery = {.charge_percent = 100};
+
+  for (int minute = 1; minute <= 24 * 60; minute++)
+  {
+    const int hour = (minute / 60) % 24;
+
+    // Awake and moving between 07:00 and 23:00, with quiet stretches.
+    // The firmware posts a movement update for each minute with activity.
+    stub_set_time(TIMELINE_START + minute * 60);
+    if (hour >= 7 && hour < 23 && bench_rand() % 3 == 0)
+    {
+      stub_add_health(HealthMetricStepCount, bench_rand() % 120);
+      stub_add_health(HealthMetricActiveSeconds, bench_rand() % 60);
+      stub_add_health(HealthMetricActiveKCalories, bench_rand() % 4);
+      stub_fire_health_event(HealthEventMovementUpdate);
+    }
+
+    phone_day_weather(hour, &s_phone_temperature, &s_phone_conditions);
+    tick_minute(minute);
+
+    if (minute % 15 == 0 && battery.charge_percent > 10)
+    {
+      battery.charge_percent -= 1;
+      stub_fire_battery(battery);
+    }
+  }
+  return true;
+}
+
+// The day timeline with quiet hours from 23:00 to 07:00.
+static bool run_quiet(void)
+{
+  uint8_t message[64];
+  DictionaryIterator iter;
+  dict_write_begin(&iter, message, sizeof(message));
+  dict_write_int32(&iter, MESSAGE_KEY_QUIET_START, 23);
+  dict_write_int32(&iter, MESSAGE_KEY_QUIET_END, 7);
+  stub_deliver_inbox(message, dict_write_end(&iter));
+  return run_day();
+}
+
+// The day timeline with the phone also sending the next 24 hours.
+static bool run_forecast(void)
+{
+  s_phone_sends_forecast = true;
+  return run_day();
+}
+
+static bool run_offline(void)
+{
+  for (int minute = 1; minute <= 12 * 60; minute++)
+  {
+    const int hour = minute / 60;
+    if (minute % 60 == 0)
+    {
+      phone_set_link(hour >= 2 && hour < 5 ? PhoneDisconnected : hour >= 5 && hour < 9 ? PhoneNoNetwork : PhoneOnline);
+    }
+    tick_minute(minute);
+  }
+  return true;
+}
+
+static bool run_config(void)
+{
+  uint8_t message[256];
+  for (int save = 0; save < 20; save++)
+  {
+    // Most saves resend the same values; every fourth changes the accent.
+    int32_t accent = save % 4 == 3 ? 0xFF5500 : 0x55FFAA;
+    uint16_t length = phone_config_message(message, sizeof(message), accent);
+    if (length)
+    {
+      stub_deliver_inbox(message, length);
+    }
+    phone_service_outbox();
+  }
+  return true;
+}
+
+static bool run_weather(void)
+{
+  uint8_t message[256];
+  for (int reply = 0; reply < 200; reply++)
+  {
+    s_phone_temperature = 10 + (reply / 10) % 5;
+    s_phone_conditions = (reply / 50) % 6;
+    stub_deliver_inbox(message, phone_weather_message(message, sizeof(message)));
+  }
+  return true;
+}
+
+// Extra result lines a scenario wants printed under its report header.
+static char s_scenario_report[2048];
+
+// Appends a failed check to the scenario report. Returns ok, so a scenario
+// can fold its checks into its result.
+static bool scenario_check(bool ok, const char *check)
+{
+  if (!ok)
+  {
+    const size_t used = strlen(s_scenario_report);
+    snprintf(s_scenario_report + used, sizeof(s_scenario_report) - used, "check failed: %s\n", check);
+  }
+  return ok;
+}
+
+// The face restarts whenever the user leaves an app or a menu. Four hours of
+// forecast replies with a relaunch every ten minutes after the first hour:
+// weather that is still fresh in storage must not be fetched again.
+#define RELAUNCH_MINUTES 10
+
+static bool run_relaunch(void)
+{
+  s_phone_sends_forecast = true;
+  uint32_t relaunches = 0;
+  for (int minute = 1; minute <= 4 * 60; minute++)
+  {
+    if (minute > 60 && minute % RELAUNCH_MINUTES == 0)
+    {
+      deinit();
+      // A relaunch starts a new process: nothing but storage survives.
+      memset(&s_weather, 0, sizeof(s_weather));
+      init();
+      relaunches++;
+    }
+    phone_day_weather(minute / 60, &s_phone_temperature, &s_phone_conditions);
+    tick_minute(minute);
+  }
+  snprintf(s_scenario_report, sizeof(s_scenario_report), "%-26s %10u\n%-26s %10u\n",
+           "relaunches", relaunches, "weather_requests", stub_counters.outbox_sends);
+  return true;
+}
+
+static uint32_t perf_u16(const uint8_t *bytes)
+{
+  return bytes[0] | bytes[1] << 8;
+}
+
+static uint32_t perf_u32(const uint8_t *bytes)
+{
+  return perf_u16(bytes) | perf_u16(bytes + 2) << 16;
+}
+
+// The quiet hours timeline, whose 07:00 resume has eight hours of step
+// history to catch up on, and whose battery runs low at 20:00. An hour on
+// the charger lets the ring catch up again before it is checked against
+// hourly sums.
+static bool run_steps(void)
+{
+  bool passed = run_quiet();
+  stub_fire_battery((BatteryChargeState){.charge_percent = 20, .is_charging = true});
+  for (int minute = 24 * 60 + 1; minute <= 25 * 60; minute++)
+  {
+    tick_minute(minute);
+  }
+  const uint32_t max_tick = s_max_tick_minute_records;
+  const time_t hour = stub_now() - stub_now() % 3600;
+  int mismatched = 0;
+  for (int ago = 1; ago < STEP_HISTORY_HOURS; ago++)
+  {
+    const time_t start = hour - ago * 3600;
+    if (health_service_sum(HealthMetricStepCount, start, start + 3600) != step_history_get(start))
+    {
+      mismatched++;
+    }
+  }
+  snprintf(s_scenario_report, sizeof(s_scenario_report), "%-26s %10u\n%-26s %10d\n",
+           "max_records_per_tick", (unsigned)max_tick, "mismatched_hours", mismatched);
+  passed &= scenario_check(max_tick <= STEP_HISTORY_SYNC_MINUTES, "max_records_per_tick <= STEP_HISTORY_SYNC_MINUTES");
+  passed &= scenario_check(mismatched == 0, "mismatched_hours == 0");
+  return passed;
+}
+
+// Timeline Quick View's height on rectangular displays.
+#define QUICK_VIEW_HEIGHT (PBL_DISPLAY_HEIGHT > 168 ? 70 : 51)
+#define QUICK_VIEW_FRAMES 8
+
+// Quick View sliding in and out again, with the face ticking underneath.
+static bool run_peek(void)
+{
+  int16_t peek_y = 0;
+  for (int peek = 0; peek < 20; peek++)
+  {
+    stub_animate_obstruction(QUICK_VIEW_HEIGHT, QUICK_VIEW_FRAMES);
+    peek_y = s_view_frames[VIEW_HEALTH].origin.y;
+    tick_minute(peek);
+    stub_animate_obstruction(0, QUICK_VIEW_FRAMES);
+  }
+  snprintf(s_scenario_report, sizeof(s_scenario_report), "%-26s %10d %10d\n", "arcs_y peek/rest",
+           peek_y, s_view_frames[VIEW_HEALTH].origin.y);
+  return true;
+}
+
+// Golden frames
+
+// Where captured frames and diffs go, next to the binary, and where the
+// goldens live; GOLDEN_UPDATE=1 rewrites the goldens instead.
+static char s_frames_dir[256];
+static const char *s_golden_dir = "golden";
+
+static const char *platform_name(void);
+
+static bool make_dir(const char *path)
+{
+  return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+// Writes the frame on screen as <name>.png and checks it against its golden.
+// Returns false if it differs or the golden cannot be written.
+static bool capture_frame(const char *name)
+{
+  const GBitmap *frame = stub_frame_buffer();
+  const size_t used = strlen(s_scenario_report);
+  char *report = s_scenario_report + used;
+  const size_t room = sizeof(s_scenario_report) - used;
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s.png", s_frames_dir, name);
+  raster_write_png(frame, path);
+
+  char golden[512];
+  snprintf(golden, sizeof(golden), "%s/%s", s_golden_dir, platform_name());
+  const bool update = getenv("GOLDEN_UPDATE") != NULL;
+  if (update && !(make_dir(s_golden_dir) && make_dir(golden)))
+  {
+    snprintf(report, room, "frame %-20s cannot create %s\n", name, golden);
+    return false;
+  }
+  snprintf(golden + strlen(golden), sizeof(golden) - strlen(golden), "/%s.png", name);
+  if (update)
+  {
+    raster_write_png(frame, golden);
+    snprintf(report, room, "frame %-20s %10s\n", name, "updated");
+    return true;
+  }
+  snprintf(path, sizeof(path), "%s/%s.diff.png", s_frames_dir, name);
+  remove(path);
+  const int differing = raster_compare_png(frame, golden, path);
+  if (differing < 0)
+  {
+    snprintf(report, room, "frame %-20s %10s %s\n", name, "missing", golden);
+  }
+  else
+  {
+    snprintf(report, room, "frame %-20s %10d px differ\n", name, differing);
+  }
+  return differing == 0;
+}
+
+// A morning with steady activity and hourly weather, then the states the
+// widgets can be in: Quick View up, every goal met and power saving.
+static bool run_frames(void)
+{
+  bool passed = capture_frame("start");
+
+  BatteryChargeState battery = {.charge_percent = 100};
+  for (int minute = 1; minute <= 9 * 60; minute++)
+  {
+    const int hour = minute / 60;
+    stub_set_time(TIMELINE_START + minute * 60);
+    if (hour >= 7 && minute % 5 == 0)
+    {
+      stub_add_health(HealthMetricStepCount, 400);
+      stub_add_health(HealthMetricActiveSeconds, 120);
+      stub_add_health(HealthMetricActiveKCalories, 10);
+      stub_fire_health_event(HealthEventMovementUpdate);
+    }
+    phone_day_weather(hour, &s_phone_temperature, &s_phone_conditions);
+    tick_minute(minute);
+    if (minute % 30 == 0)
+    {
+      battery.charge_percent -= 2;
+      stub_fire_battery(battery);
+    }
+  }
+  passed &= capture_frame("morning");
+
+  stub_animate_obstruction(QUICK_VIEW_HEIGHT, QUICK_VIEW_FRAMES);
+  passed &= capture_frame("peek");
+  stub_animate_obstruction(0, QUICK_VIEW_FRAMES);
+
+  stub_add_health(HealthMetricStepCount, 8000);
+  stub_add_health(HealthMetricActiveSeconds, 45 * 60);
+  stub_add_health(HealthMetricActiveKCalories, 400);
+  stub_fire_health_event(HealthEventSignificantUpdate);
+  tick_minute(9 * 60 + 1);
+  passed &= capture_frame("goals");
+
+  uint8_t message[256];
+  stub_deliver_inbox(message, phone_places_message(message, sizeof(message), stub_now()));
+  stub_fire_tap(ACCEL_AXIS_X, 1);
+  passed &= capture_frame("place");
+  for (int place = 0; place < PHONE_PLACE_COUNT; place++)
+  {
+    stub_fire_tap(ACCEL_AXIS_X, 1);
+  }
+
+  battery.charge_percent = 15;
+  stub_fire_battery(battery);
+  passed &= capture_frame("saving");
+  return passed;
+}
+
+// The offline timeline, then a dump request riding on a weather reply.
+static bool run_perf(void)
+{
+  const bool passed = run_offline();
+
+  uint8_t message[256];
+  DictionaryIterator iter;
+  dict_write_begin(&iter, message, sizeof(message));
+  dict_write_uint8(&iter, MESSAGE_KEY_PERF_DUMP, 1);
+  stub_deliver_inbox(message, dict_write_end(&iter));
+  phone_service_outbox();
+
+  const uint8_t *p = s_phone_perf;
+  if (s_phone_perf_length < PERF_PAYLOAD_HEADER_SIZE || p[0] != PERF_PAYLOAD_VERSION)
+  {
+    snprintf(s_scenario_report, sizeof(s_scenario_report), "no perf payload received\n");
+    return false;
+  }
+  int length = snprintf(s_scenario_report, sizeof(s_scenario_report),
+                        "%-26s %10u\n%-26s %10u\n%-26s %10u / %u\n%-26s %10u / %u\n%-26s %10u / %u\n"
+                        "%-26s %10u\n%-26s %10u %u %u\n%-26s %10u\n",
+                        "perf_payload_bytes", s_phone_perf_length,
+                        "perf_uptime_s", perf_u32(p + 1),
+                        "perf_inbox ok/dropped", perf_u16(p + 5), perf_u16(p + 7),
+                        "perf_outbox ok/failed", perf_u16(p + 9), perf_u16(p + 11),
+                        "perf_weather n/max_ms", perf_u16(p + 13), perf_u16(p + 15),
+                        "perf_weather_timeouts", perf_u16(p + 21),
+                        "perf_draw_max_ms t/h/b", perf_u16(p + 23), perf_u16(p + 25), perf_u16(p + 27),
+                        "perf_heap_free_min", perf_u32(p + 29));
+  for (int i = 0; i < p[PERF_PAYLOAD_HEADER_SIZE - 1] && length < (int)sizeof(s_scenario_report); i++)
+  {
+    const uint8_t *event = p + PERF_PAYLOAD_HEADER_SIZE + i * PERF_PAYLOAD_EVENT_SIZE;
+    length += snprintf(s_scenario_report + length, sizeof(s_scenario_report) - length,
+                       "perf_event_%-15d kind %d detail %d value %u age_s %u\n", i, event[0], event[1],
+                       perf_u16(event + 2), perf_u16(event + 4));
+  }
+  return passed;
+}
+
+// Appends what the weather widgets show, as "name temperature".
+static int report_shown(int length)
+{
+  return length + snprintf(s_scenario_report + length, sizeof(s_scenario_report) - length, " %s %s",
+                           s_place_shown ? places_name(s_place_shown - 1) : s_settings.location, temp_buffer);
+}
+
+// Saved places arrive once, then the wrist is tapped through them every
+// five minutes for three hours while the day timeline runs.
+static bool run_places(void)
+{
+  const bool tap_before_places = stub_tap_subscribed();
+  uint8_t message[256];
+  stub_deliver_inbox(message, phone_places_message(message, sizeof(message), stub_now()));
+  const bool tap_with_places = stub_tap_subscribed();
+
+  uint32_t taps = 0, tap_outbox_sends = 0, tap_frames = 0;
+  int length = 0;
+  for (int minute = 1; minute <= 3 * 60; minute++)
+  {
+    phone_day_weather(minute / 60, &s_phone_temperature, &s_phone_conditions);
+    tick_minute(minute);
+    if (minute % 5)
+    {
+      continue;
+    }
+    const bool logged = minute == 5 || minute == 2 * 60 + 30;
+    if (logged)
+    {
+      length += snprintf(s_scenario_report + length, sizeof(s_scenario_report) - length, "%-26s", minute == 5 ? "places_cycle" : "places_cycle_2h30");
+      length = report_shown(length);
+    }
+    for (int tap = 0; tap <= PHONE_PLACE_COUNT; tap++)
+    {
+      const uint32_t sends = stub_counters.outbox_sends;
+      const uint32_t frames = stub_counters.frames;
+      stub_fire_tap(ACCEL_AXIS_Y, 1);
+      taps++;
+      tap_outbox_sends += stub_counters.outbox_sends - sends;
+      tap_frames += stub_counters.frames - frames;
+      if (logged && tap < PHONE_PLACE_COUNT)
+      {
+        length += snprintf(s_scenario_report + length, sizeof(s_scenario_report) - length, " >");
+        length = report_shown(length);
+      }
+    }
+    if (logged)
+    {
+      length += snprintf(s_scenario_report + length, sizeof(s_scenario_report) - length, "\n");
+    }
+  }
+  snprintf(s_scenario_report + length, sizeof(s_scenario_report) - length,
+           "%-26s %10u\n%-26s %10u\n%-26s %10u\n%-26s %10d %10d\n",
+           "places_taps", taps, "places_tap_frames", tap_frames, "places_tap_outbox_sends", tap_outbox_sends,
+           "tap_subscribed before/with", tap_before_places, tap_with_places);
+  return true;
+}
+
+// A lossy phone link, stepped a second at a time: the phone answers each
+// message after LINK_LATENCY_SECONDS, NACKing one in five, and lets one in
+// ten go unanswered until the firmware times it out. Weather is asked for
+// every minute and dump requests land while a weather request is in flight,
+// so messages queue behind each other.
+#define LINK_SECONDS (6 * 60 * 60)
+#define LINK_LATENCY_SECONDS 2
+#define LINK_TIMEOUT_SECONDS 10
+#define LINK_DUMP_SECONDS (7 * 60)
+// Weather is due every minute; a lost request costs the two-minute reply
+// timeout and the backoff after it, so a longer gap means requests stall.
+#define LINK_MAX_REPLY_GAP_SECONDS (5 * 60)
+
+static bool run_link(void)
+{
+  uint8_t message[256];
+  DictionaryIterator iter;
+  dict_write_begin(&iter, message, sizeof(message));
+  dict_write_int32(&iter, MESSAGE_KEY_UPDATE_INTERVAL, 1);
+  stub_deliver_inbox(message, dict_write_end(&iter));
+
+  uint32_t acked = 0, nacked = 0, timed_out = 0;
+  uint32_t replies = 0, dumps_asked = 0, dumps_received = 0;
+  int last_reply = 0, max_reply_gap = 0;
+  bool answering = false;
+  int answer_at = 0;
+  AppMessageResult answer = APP_MSG_OK;
+
+  for (int second = 1; second <= LINK_SECONDS; second++)
+  {
+    stub_advance_ms(1000);
+    if (second % 60 == 0)
+    {
+      fire_minute_tick();
+    }
+    if (second % LINK_DUMP_SECONDS == 1)
+    {
+      dict_write_begin(&iter, message, sizeof(message));
+      dict_write_uint8(&iter, MESSAGE_KEY_PERF_DUMP, 1);
+      stub_deliver_inbox(message, dict_write_end(&iter));
+      dumps_asked++;
+    }
+
+    uint8_t request[256];
+    const uint16_t request_size = stub_phone_take_outbox(request, sizeof(request));
+    if (!request_size)
+    {
+      answering = false;
+      continue;
+    }
+    if (!answering)
+    {
+      const uint32_t roll = bench_rand() % 10;
+      answering = true;
+      answer = roll == 0 ? APP_MSG_SEND_TIMEOUT : roll <= 2 ? APP_MSG_SEND_REJECTED : APP_MSG_OK;
+      answer_at = second + (roll == 0 ? LINK_TIMEOUT_SECONDS : LINK_LATENCY_SECONDS);
+    }
+    if (second < answer_at)
+    {
+      continue;
+    }
+    answering = false;
+    stub_phone_ack_outbox(answer);
+    if (answer == APP_MSG_SEND_TIMEOUT)
+    {
+      timed_out++;
+      continue;
+    }
+    if (answer != APP_MSG_OK)
+    {
+      nacked++;
+      continue;
+    }
+    acked++;
+    dict_read_begin_from_buffer(&iter, request, request_size);
+    if (dict_find(&iter, MESSAGE_KEY_PERF))
+    {
+      dumps_received++;
+      continue;
+    }
+    stub_deliver_inbox(message, phone_weather_message(message, sizeof(message)));
+    replies++;
+    if (second - last_reply > max_reply_gap)
+    {
+      max_reply_gap = second - last_reply;
+    }
+    last_reply = second;
+  }
+
+  snprintf(s_scenario_report, sizeof(s_scenario_report),
+           "%-26s %10u / %u / %u\n%-26s %10u\n%-26s %10d\n%-26s %10u / %u\n",
+           "link_sends ok/nack/timeout", acked, nacked, timed_out,
+           "link_weather_replies", replies,
+           "link_max_reply_gap_s", max_reply_gap,
+           "link_dumps asked/received", dumps_asked, dumps_received);
+  // Both kinds of message the watch queues have to get through.
+  bool passed = scenario_check(replies > 0, "link_weather_replies > 0");
+  passed &= scenario_check(dumps_received > 0 && dumps_received >= dumps_asked, "link_dumps received >= asked");
+  passed &= scenario_check(max_reply_gap <= LINK_MAX_REPLY_GAP_SECONDS,
+                           "link_max_reply_gap_s <= LINK_MAX_REPLY_GAP_SECONDS");
+  return passed;
+}
+
+// The float arc math the update procs used before arc_math.c, kept as the
+// reference the fixed-point kernel is timed and checked against.
+static int32_t float_arc_angle(int32_t value, int32_t goal)
+{
+  int degrees = (int)((float)value / (float)goal * 360.0);
+  return DEG_TO_TRIGANGLE(degrees > 360 ? 360 : degrees);
+}
+
+static GPoint float_temperature_marker(int cur_temp, int low, int high)
+{
+  cur_temp = cur_temp < low ? low : cur_temp > high ? high : cur_temp;
+  float relative_temp = (float)(cur_temp - low) / (float)(high - low);
+  float angle = 235 + (485 - 235) * relative_temp;
+  int x = (int)(ARC_WIDTH / 2 + (ARC_WIDTH / 2 - 2) * sin_lookup(DEG_TO_TRIGANGLE(angle)) / TRIG_MAX_RATIO);
+  int y = (int)(ARC_WIDTH / 2 - (ARC_WIDTH / 2 - 2) * cos_lookup(DEG_TO_TRIGANGLE(angle)) / TRIG_MAX_RATIO);
+  return GPoint(x, y);
+}
+
+static bool run_arc_math(void)
+{
+  static const int32_t GOALS[] = {30, 300, 5000, 50000};
+  volatile int32_t sink = 0;
+  int32_t max_angle_error = 0;
+  int max_marker_error = 0;
+
+  uint64_t float_ns = 0;
+  uint64_t fixed_ns = 0;
+  for (size_t g = 0; g < ARRAY_LENGTH(GOALS); g++)
+  {
+    const int32_t goal = GOALS[g];
+    uint64_t start = bench_now_ns();
+    for (int32_t value = 0; value <= goal + goal / 4; value++)
+    {
+      sink += float_arc_angle(value, goal);
+    }
+    float_ns += bench_now_ns() - start;
+    start = bench_now_ns();
+    for (int32_t value = 0; value <= goal + goal / 4; value++)
+    {
+      sink += arc_steps_to_angle(arc_steps(value, goal));
+    }
+    fixed_ns += bench_now_ns() - start;
+    for (int32_t value = 0; value <= goal + goal / 4; value++)
+    {
+      const int32_t error = abs(float_arc_angle(value, goal) - arc_steps_to_angle(arc_steps(value, goal)));
+      max_angle_error = error > max_angle_error ? error : max_angle_error;
+    }
+  }
+  int length = snprintf(s_scenario_report, sizeof(s_scenario_report), "%-26s %10.1f %10.1f %10.2f\n", "arc_angle float/fixed_us", float_ns / 1e3, fixed_ns / 1e3,
+         TRIGANGLE_TO_DEG((double)max_angle_error));
+
+  float_ns = fixed_ns = 0;
+  for (int low = -30; low <= 30; low += 3)
+  {
+    for (int high = low + 1; high <= low + 25; high += 4)
+    {
+      uint64_t start = bench_now_ns();
+      for (int temp = low - 5; temp <= high + 5; temp++)
+      {
+        sink += float_temperature_marker(temp, low, high).x;
+      }
+      float_ns += bench_now_ns() - start;
+      start = bench_now_ns();
+      for (int temp = low - 5; temp <= high + 5; temp++)
+      {
+        sink += arc_temperature_marker(temp, low, high).x;
+      }
+      fixed_ns += bench_now_ns() - start;
+      for (int temp = low - 5; temp <= high + 5; temp++)
+      {
+        const GPoint a = float_temperature_marker(temp, low, high);
+        const GPoint b = arc_temperature_marker(temp, low, high);
+        const int error = abs(a.x - b.x) > abs(a.y - b.y) ? abs(a.x - b.x) : abs(a.y - b.y);
+        max_marker_error = error > max_marker_error ? error : max_marker_error;
+      }
+    }
+  }
+  snprintf(s_scenario_report + length, sizeof(s_scenario_report) - length, "%-26s %10.1f %10.1f %10d\n", "marker float/fixed_us", float_ns / 1e3, fixed_ns / 1e3, max_marker_error);
+  (void)sink;
+  return true;
+}
+
+static const Scenario SCENARIOS[] = {
+    {"cold_start", "start on a configured watch and draw the first frame", run_cold_start, false, false},
+    {"migrate", "first start after upgrading from per-key storage", run_cold_start, true, false},
+    {"day", "24h of minute ticks with health, battery and weather replies", run_day, false, false},
+    {"quiet", "the day timeline with quiet hours from 23:00 to 07:00", run_quiet, false, false},
+    {"steps", "step history across the quiet hours timeline, checked against hourly sums", run_steps, false, false},
+    {"forecast", "the day timeline with an hourly forecast in every reply", run_forecast, false, false},
+    {"offline", "12h with the phone out of range for 3h, then without network for 4h", run_offline, false, false},
+    {"relaunch", "4h of forecast replies, relaunching every 10 minutes after the first hour", run_relaunch, false, false},
+    {"config", "20 Clay settings saves, mostly unchanged", run_config, false, false},
+    {"weather", "200 weather replies with occasional changes", run_weather, false, false},
+    {"peek", "20 Timeline Quick View peeks, 8 animation frames each way", run_peek, false, false},
+    {"perf", "the offline timeline, then a performance counter dump", run_perf, false, false},
+    {"places", "3 saved places from one message, tapped through every 5 minutes for 3h", run_places, false, false},
+    {"link", "6h over a link that NACKs or drops some messages, with dump requests racing weather", run_link, false, false},
+    {"arc_math", "fixed-point arc kernel against the old float math (max error in deg / px)", run_arc_math, false, false},
+    {"frames", "rasterized frames against the goldens, with overdraw per update proc", run_frames, false, true},
+};
+#define SCENARIO_COUNT (int)(sizeof(SCENARIOS) / sizeof(SCENARIOS[0]))
+
+// Reporting
+
+static const Scenario *s_scenario;
+static StubCounters s_startup_counters;
+static uint64_t s_start_ns;
+static uint64_t s_startup_ns;
+static uint64_t s_timeline_ns;
+static size_t s_heap_after_load;
+static size_t s_heap_free_after_load;
+static bool s_passed;
+
+static void bench_event_loop(void)
+{
+  s_startup_ns = bench_now_ns() - s_start_ns;
+  s_startup_counters = stub_counters;
+  memset(&stub_counters, 0, sizeof(stub_counters));
+  s_heap_after_load = heap_bytes_used();
+  s_heap_free_after_load = heap_bytes_free();
+  stub_heap_reset_peak();
+
+  uint64_t timeline_start = bench_now_ns();
+  s_passed = s_scenario->run();
+  s_timeline_ns = bench_now_ns() - timeline_start;
+}
+
+static const char *platform_name(void)
+{
+  switch (PBL_PLATFORM_TYPE_CURRENT)
+  {
+  case PlatformTypeAplite:
+    return "aplite";
+  case PlatformTypeBasalt:
+    return "basalt";
+  case PlatformTypeChalk:
+    return "chalk";
+  case PlatformTypeDiorite:
+    return "diorite";
+  case PlatformTypeEmery:
+    return "emery";
+  }
+  return "unknown";
+}
+
+static void name_probes(void)
+{
+  stub_probe_name(tick_handler, "tick_handler");
+  stub_probe_name(battery_callback, "battery_callback");
+  stub_probe_name(health_handler, "health_handler");
+  stub_probe_name(app_connection_handler, "app_connection_handler");
+  stub_probe_name(inbox_recv_callback, "inbox_recv_callback");
+  stub_probe_name(inbox_dropped_callback, "inbox_dropped_callback");
+  stub_probe_name(outbox_sent_callback, "outbox_sent_callback");
+  stub_probe_name(outbox_failed_callback, "outbox_failed_callback");
+  stub_probe_name(temperature_update_proc, "temperature_update_proc");
+  stub_probe_name(health_update_proc, "health_update_proc");
+  stub_probe_name(step_history_update_proc, "step_history_update_proc");
+  stub_probe_name(battery_update_proc, "battery_update_proc");
+  stub_probe_name(unobstructed_change, "unobstructed_change");
+  stub_probe_name(accel_tap_handler, "accel_tap_handler");
+  stub_probe_name(app_timer_register, "app_timer");
+#if defined(MODULUS_DISPLAY_LIST)
+  stub_probe_name(display_list_update_proc, "display_list_update_proc");
+#endif
+  stub_probe_name(stub_render, "render");
+}
+
+static void print_report(void)
+{
+  printf("== %s on %s: %s\n", s_scenario->name, platform_name(), s_scenario->description);
+
+  printf("%s", s_scenario_report);
+  printf("%-26s %10s %10s\n", "counter", "startup", "timeline");
+#define PRINT_COUNTER(name) printf("%-26s %10u %10u\n", #name, s_startup_counters.name, stub_counters.name);
+  STUB_COUNTERS(PRINT_COUNTER)
+#undef PRINT_COUNTER
+
+  printf("%-26s %10s %10s %10s %10s\n", "handler", "calls", "total_us", "avg_us", "max_us");
+  int probe_count;
+  const StubProbe *probes = stub_probes(&probe_count);
+  for (int i = 0; i < probe_count; i++)
+  {
+    const StubProbe *probe = &probes[i];
+    if (!probe->calls)
+    {
+      continue;
+    }
+    printf("%-26s %10u %10.1f %10.2f %10.2f\n", probe->name ? probe->name : "(unnamed)", probe->calls,
+           probe->total_ns / 1e3, probe->total_ns / 1e3 / probe->calls, probe->max_ns / 1e3);
+  }
+  printf("%-26s %10.3f\n", "startup_ms", s_startup_ns / 1e6);
+  printf("%-26s %10.3f\n", "timeline_ms", s_timeline_ns / 1e6);
+  printf("%-26s %10zu\n", "heap_after_load", s_heap_after_load);
+  printf("%-26s %10zu\n", "heap_free_after_load", s_heap_free_after_load);
+  printf("%-26s %10zu\n", "heap_peak_timeline", stub_heap_peak());
+
+  if (raster_enabled())
+  {
+    printf("%-26s %10s %10s %10s %10s\n", "pixels", "calls", "writes", "touched", "overdraw");
+    int owner_count;
+    const RasterOwnerStats *owners = raster_owner_stats(&owner_count);
+    for (int i = 0; i < owner_count; i++)
+    {
+      const RasterOwnerStats *owner = &owners[i];
+      printf("%-26s %10u %10llu %10llu %10.2f\n", owner->owner, owner->calls, (unsigned long long)owner->writes,
+             (unsigned long long)owner->touched, owner->touched ? (double)owner->writes / owner->touched : 0.0);
+    }
+    uint32_t frames;
+    uint64_t touched;
+    raster_frame_stats(&frames, &touched);
+    printf("%-26s %10.0f %9.1f%%\n", "touched_per_frame", frames ? (double)touched / frames : 0.0,
+           frames ? 100.0 * touched / frames / (PBL_DISPLAY_WIDTH * PBL_DISPLAY_HEIGHT) : 0.0);
+  }
+  printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+  if (argc != 2)
+  {
+    fprintf(stderr, "usage: %s <scenario>\n", argv[0]);
+    for (int i = 0; i < SCENARIO_COUNT; i++)
+    {
+      fprintf(stderr, "  %-12s %s\n", SCENARIOS[i].name, SCENARIOS[i].description);
+    }
+    return 2;
+  }
+  for (int i = 0; i < SCENARIO_COUNT; i++)
+  {
+    if (strcmp(argv[1], SCENARIOS[i].name) == 0)
+    {
+      s_scenario = &SCENARIOS[i];
+    }
+  }
+  if (!s_scenario)
+  {
+    fprintf(stderr, "unknown scenario '%s'\n", argv[1]);
+    return 2;
+  }
+
+  if (s_scenario->rasterize)
+  {
+    raster_enable();
+#if defined(MODULUS_DISPLAY_LIST)
+    const char *variant = "frames_display_list";
+#else
+    const char *variant = "frames";
+#endif
+    char binary[256];
+    snprintf(binary, sizeof(binary), "%s", argv[0]);
+    snprintf(s_frames_dir, sizeof(s_frames_dir), "%s/%s", dirname(binary), variant);
+    if (!make_dir(s_frames_dir))
+    {
+      fprintf(stderr, "cannot create %s\n", s_frames_dir);
+      return 1;
+    }
+    if (getenv("GOLDEN_DIR"))
+    {
+      s_golden_dir = getenv("GOLDEN_DIR");
+    }
+  }
+
+  setenv("TZ", "UTC", 1);
+  tzset();
+  stub_set_time(TIMELINE_START);
+  name_probes();
+  seed_configured_watch();
+  if (!s_scenario->legacy_storage)
+  {
+    settings_load();
+  }
+  memset(&stub_counters, 0, sizeof(stub_counters));
+
+  stub_set_event_loop(bench_event_loop);
+  s_start_ns = bench_now_ns();
+  modulus_main();
+  print_report();
+  if (!s_passed)
+  {
+    fprintf(stderr, "%s failed on %s\n", s_scenario->name, platform_name());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,31 @@
+// Mirrors the message_keys.auto.c the SDK generates: keys are numbered from
+// 10000 in package.json order.
+#include "message_keys.auto.h"
+
+uint32_t MESSAGE_KEY_CUR_TEMP = 10000;
+uint32_t MESSAGE_KEY_HIGH_TEMP = 10001;
+uint32_t MESSAGE_KEY_LOW_TEMP = 10002;
+uint32_t MESSAGE_KEY_CONDITIONS = 10003;
+uint32_t MESSAGE_KEY_LOCATION = 10004;
+uint32_t MESSAGE_KEY_UNITS = 10005;
+uint32_t MESSAGE_KEY_UPDATE_INTERVAL = 10006;
+uint32_t MESSAGE_KEY_STEP_GOAL = 10007;
+uint32_t MESSAGE_KEY_MOVE_GOAL = 10008;
+uint32_t MESSAGE_KEY_CAL_GOAL = 10009;
+uint32_t MESSAGE_KEY_BACKGROUND_COLOUR = 10010;
+uint32_t MESSAGE_KEY_ACCENT_COLOUR = 10011;
+uint32_t MESSAGE_KEY_HEALTH_OUTER_ARC_COLOUR = 10012;
+uint32_t MESSAGE_KEY_HEALTH_MIDDLE_ARC_COLOUR = 10013;
+uint32_t MESSAGE_KEY_HEALTH_INNER_ARC_COLOUR = 10014;
+uint32_t MESSAGE_KEY_OWM_API_KEY = 10015;
+uint32_t MESSAGE_KEY_LOCATION_NAME = 10016;
+uint32_t MESSAGE_KEY_WEATHER = 10017;
+uint32_t MESSAGE_KEY_WEATHER_CACHE_MINUTES = 10018;
+uint32_t MESSAGE_KEY_PERF_DUMP = 10019;
+uint32_t MESSAGE_KEY_PERF = 10020;
+uint32_t MESSAGE_KEY_LOW_POWER_LEVEL = 10021;
+uint32_t MESSAGE_KEY_QUIET_START = 10022;
+uint32_t MESSAGE_KEY_QUIET_END = 10023;
+uint32_t MESSAGE_KEY_FORECAST = 10024;
+uint32_t MESSAGE_KEY_SAVED_PLACES = 10025;
+uint32_t MESSAGE_KEY_PLACES = 10026;
@@ -0,0 +1,35 @@
+// Mirrors the build/include/message_keys.auto.h the SDK generates from the
+// messageKeys list in package.json. Like the SDK, the keys are variables,
+// not constants, so they cannot be used as case labels. Keep the order in
+// sync with package.json.
+#pragma once
+
+#include <stdint.h>
+
+extern uint32_t MESSAGE_KEY_CUR_TEMP;
+extern uint32_t MESSAGE_KEY_HIGH_TEMP;
+extern uint32_t MESSAGE_KEY_LOW_TEMP;
+extern uint32_t MESSAGE_KEY_CONDITIONS;
+extern uint32_t MESSAGE_KEY_LOCATION;
+extern uint32_t MESSAGE_KEY_UNITS;
+extern uint32_t MESSAGE_KEY_UPDATE_INTERVAL;
+extern uint32_t MESSAGE_KEY_STEP_GOAL;
+extern uint32_t MESSAGE_KEY_MOVE_GOAL;
+extern uint32_t MESSAGE_KEY_CAL_GOAL;
+extern uint32_t MESSAGE_KEY_BACKGROUND_COLOUR;
+extern uint32_t MESSAGE_KEY_ACCENT_COLOUR;
+extern uint32_t MESSAGE_KEY_HEALTH_OUTER_ARC_COLOUR;
+extern uint32_t MESSAGE_KEY_HEALTH_MIDDLE_ARC_COLOUR;
+extern uint32_t MESSAGE_KEY_HEALTH_INNER_ARC_COLOUR;
+extern uint32_t MESSAGE_KEY_OWM_API_KEY;
+extern uint32_t MESSAGE_KEY_LOCATION_NAME;
+extern uint32_t MESSAGE_KEY_WEATHER;
+extern uint32_t MESSAGE_KEY_WEATHER_CACHE_MINUTES;
+extern uint32_t MESSAGE_KEY_PERF_DUMP;
+extern uint32_t MESSAGE_KEY_PERF;
+extern uint32_t MESSAGE_KEY_LOW_POWER_LEVEL;
+extern uint32_t MESSAGE_KEY_QUIET_START;
+extern uint32_t MESSAGE_KEY_QUIET_END;
+extern uint32_t MESSAGE_KEY_FORECAST;
+extern uint32_t MESSAGE_KEY_SAVED_PLACES;
+extern uint32_t MESSAGE_KEY_PLACES;
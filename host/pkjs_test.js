@@ -0,0 +1,550 @@
+// Runs src/pkjs/weather.js under Node against a local mock of open-meteo and
+// the OWM geocoder, src/pkjs/outbox.js against a scripted watch, the saved
+// places schedule in src/pkjs/places.js on a fake clock and the settings
+// sync in src/pkjs/settings.js. `make pkjs` runs it; it needs nothing
+// beyond Node.
+"use strict";
+
+var assert = require("assert");
+var http = require("http");
+var url = require("url");
+
+// PebbleKit JS globals
+
+var storage = {};
+global.localStorage = {
+  getItem: function (key) {
+    return Object.prototype.hasOwnProperty.call(storage, key) ? storage[key] : null;
+  },
+  setItem: function (key, value) {
+    storage[key] = String(value);
+  },
+};
+
+// Just the XMLHttpRequest surface weather.js uses.
+function XMLHttpRequest() {}
+XMLHttpRequest.prototype.open = function (method, target) {
+  this.method = method;
+  this.target = target;
+};
+XMLHttpRequest.prototype.send = function () {
+  var self = this;
+  this.request = http.get(this.target, function (response) {
+    var body = "";
+    response.on("data", function (chunk) {
+      body += chunk;
+    });
+    response.on("end", function () {
+      self.status = response.statusCode;
+      self.responseText = body;
+      if (self.onload) {
+        self.onload();
+      }
+    });
+  });
+  this.request.on("error", function () {
+    if (!self.aborted && self.onerror) {
+      self.onerror();
+    }
+  });
+};
+XMLHttpRequest.prototype.abort = function () {
+  this.aborted = true;
+  this.request.destroy();
+};
+global.XMLHttpRequest = XMLHttpRequest;
+
+var WeatherPipeline = require("../src/pkjs/weather.js").WeatherPipeline;
+var Outbox = require("../src/pkjs/outbox.js").Outbox;
+var SavedPlaces = require("../src/pkjs/places.js").SavedPlaces;
+var settings = require("../src/pkjs/settings.js");
+
+// Mock server
+
+var routes = {};
+var log = [];
+
+var server = http.createServer(function (request, response) {
+  var parsed = url.parse(request.url, true);
+  var route = routes[parsed.pathname];
+  log.push({ path: parsed.pathname, at: Date.now() });
+  if (!route) {
+    response.writeHead(404);
+    response.end();
+    return;
+  }
+  setTimeout(function () {
+    response.writeHead(route.status || 200, { "Content-Type": "application/json" });
+    response.end(JSON.stringify(route.body));
+  }, route.delayMs || 0);
+});
+
+var FORECAST = {
+  current: { temperature_2m: 11.6, weather_code: 61 },
+  daily: { temperature_2m_max: [14.2], temperature_2m_min: [3.9] },
+  hourly: {
+    time: [1772409600, 1772413200],
+    temperature_2m: [11.6, 12.4],
+    weather_code: [61, 3],
+  },
+};
+var GEOCODE = [{ name: "Kitchener" }];
+var SETTINGS = { OWM_API_KEY: "key", UNITS: "C", WEATHER_CACHE_MINUTES: "30" };
+
+function pipelineFor(port, sent, options) {
+  options = options || {};
+  return new WeatherPipeline({
+    geolocate: function (callback) {
+      options.geolocations = (options.geolocations || 0) + 1;
+      setTimeout(function () {
+        callback(null, { latitude: 43.4516, longitude: -80.4925 });
+      }, 5);
+    },
+    send: function (weather) {
+      sent.push(weather);
+    },
+    forecastUrl: "http://127.0.0.1:" + port + "/v1/forecast",
+    geocodeUrl: "http://127.0.0.1:" + port + "/geo/1.0/reverse",
+    timeoutMs: options.timeoutMs || 500,
+    now: options.now,
+  });
+}
+
+function reset(forecast, geocode) {
+  storage = {};
+  log = [];
+  routes = { "/v1/forecast": forecast, "/geo/1.0/reverse": geocode };
+}
+
+function count(path) {
+  return log.filter(function (entry) {
+    return entry.path === path;
+  }).length;
+}
+
+// Tests
+
+var tests = [];
+function test(name, run) {
+  tests.push({ name: name, run: run });
+}
+
+test("fetches forecast and place name concurrently", function (port, done) {
+  reset({ body: FORECAST, delayMs: 200 }, { body: GEOCODE, delayMs: 200 });
+  var sent = [];
+  var start = Date.now();
+  pipelineFor(port, sent).update(SETTINGS, function (error, weather) {
+    var elapsed = Date.now() - start;
+    assert.ifError(error);
+    assert.strictEqual(weather.temperature, 12);
+    assert.strictEqual(weather.location, "Kitchener");
+    assert.strictEqual(weather.forecast.temperatures.length, 2);
+    assert.strictEqual(sent.length, 1);
+    // Both requests reach the server before either answers.
+    assert.ok(Math.abs(log[0].at - log[1].at) < 100, "requests were serialised");
+    assert.ok(elapsed < 380, "took " + elapsed + "ms, the sum of both round trips");
+    done();
+  });
+});
+
+test("collapses concurrent updates into one fetch", function (port, done) {
+  reset({ body: FORECAST, delayMs: 50 }, { body: GEOCODE });
+  var sent = [];
+  var options = {};
+  var pipeline = pipelineFor(port, sent, options);
+  var answers = [];
+  for (var i = 0; i < 3; i++) {
+    pipeline.update(SETTINGS, function (error, weather) {
+      answers.push(weather);
+      if (answers.length < 3) {
+        return;
+      }
+      assert.strictEqual(options.geolocations, 1);
+      assert.strictEqual(count("/v1/forecast"), 1);
+      assert.strictEqual(count("/geo/1.0/reverse"), 1);
+      assert.strictEqual(sent.length, 1);
+      assert.ok(answers[0] === answers[1] && answers[1] === answers[2]);
+      done();
+    });
+  }
+});
+
+test("reuses a recent position and fresh caches", function (port, done) {
+  reset({ body: FORECAST }, { body: GEOCODE });
+  var sent = [];
+  var options = {};
+  var pipeline = pipelineFor(port, sent, options);
+  pipeline.update(SETTINGS, function () {
+    pipeline.update(SETTINGS, function (error, weather) {
+      assert.ifError(error);
+      assert.strictEqual(options.geolocations, 1);
+      assert.strictEqual(count("/v1/forecast"), 1);
+      assert.strictEqual(count("/geo/1.0/reverse"), 1);
+      assert.strictEqual(weather.location, "Kitchener");
+      assert.strictEqual(sent.length, 2);
+      done();
+    });
+  });
+});
+
+test("answers from a fresh forecast without waiting on an old position", function (port, done) {
+  reset({ body: FORECAST }, { body: GEOCODE });
+  var sent = [];
+  // 20 minutes into an hour, so both updates share the forecast's hour.
+  var clock = 1772409600000 + 20 * 60 * 1000;
+  var options = {
+    now: function () {
+      return clock;
+    },
+  };
+  var pipeline = pipelineFor(port, sent, options);
+  pipeline.update(SETTINGS, function () {
+    // The position is too old to reuse, the forecast still within 30 minutes.
+    clock += 20 * 60 * 1000;
+    pipeline.update(SETTINGS, function (error, weather) {
+      assert.ifError(error);
+      assert.strictEqual(options.geolocations, 1);
+      assert.strictEqual(count("/v1/forecast"), 1);
+      assert.strictEqual(weather.temperature, 12);
+      done();
+    });
+  });
+});
+
+test("falls back to the last good forecast on a timeout", function (port, done) {
+  reset({ body: FORECAST }, { body: GEOCODE });
+  var sent = [];
+  var pipeline = pipelineFor(port, sent);
+  pipeline.update(SETTINGS, function () {
+    // Drop the hourly cache entry so the next update has to fetch.
+    storage["forecast-cache"] = "{}";
+    routes["/v1/forecast"] = { body: FORECAST, delayMs: 1000 };
+    var start = Date.now();
+    pipeline.update(SETTINGS, function (error, weather) {
+      assert.ifError(error);
+      assert.ok(Date.now() - start < 900, "waited past the timeout");
+      assert.strictEqual(weather.temperature, 12);
+      assert.strictEqual(weather.location, "Kitchener");
+      assert.strictEqual(sent.length, 2);
+      done();
+    });
+  });
+});
+
+test("uses the configured name when the geocoder fails", function (port, done) {
+  reset({ body: FORECAST }, { status: 500, body: {} });
+  var sent = [];
+  var settings = { OWM_API_KEY: "key", LOCATION_NAME: "Home" };
+  pipelineFor(port, sent).update(settings, function (error, weather) {
+    assert.ifError(error);
+    assert.strictEqual(weather.location, "Home");
+    assert.strictEqual(sent.length, 1);
+    done();
+  });
+});
+
+test("sends nothing without any good forecast", function (port, done) {
+  reset({ body: FORECAST, delayMs: 1000 }, { body: GEOCODE });
+  var sent = [];
+  pipelineFor(port, sent).update(SETTINGS, function (error, weather) {
+    assert.ok(error);
+    assert.strictEqual(weather, undefined);
+    assert.strictEqual(sent.length, 0);
+    done();
+  });
+});
+
+// A watch that answers each message with the next scripted reply: "ack",
+// "nack", or "none" to never answer. Unscripted messages wait in held.
+function scriptedWatch(replies) {
+  var watch = { sent: [], held: [], at: [] };
+  watch.send = function (message, ack, nack) {
+    watch.sent.push(JSON.parse(JSON.stringify(message)));
+    watch.at.push(Date.now());
+    var reply = replies.shift();
+    if (reply === "ack") {
+      setTimeout(ack, 1);
+    } else if (reply === "nack") {
+      setTimeout(nack, 1);
+    } else if (reply === undefined) {
+      watch.held.push(ack);
+    }
+  };
+  return watch;
+}
+
+function outboxFor(watch) {
+  return new Outbox({ sendAppMessage: watch.send, baseDelayMs: 20, timeoutMs: 50 });
+}
+
+test("retries a NACKed message with backoff", function (port, done) {
+  var watch = scriptedWatch(["nack", "nack", "ack"]);
+  outboxFor(watch).replace("weather", { WEATHER: [1] }, function (error) {
+    assert.ifError(error);
+    assert.strictEqual(watch.sent.length, 3);
+    assert.ok(watch.at[2] - watch.at[1] > watch.at[1] - watch.at[0]);
+    done();
+  });
+});
+
+test("retries a message the watch never answers", function (port, done) {
+  var watch = scriptedWatch(["none", "ack"]);
+  var outcomes = [];
+  outboxFor(watch).replace("weather", { WEATHER: [1] }, function (error) {
+    outcomes.push(error);
+  });
+  setTimeout(function () {
+    assert.deepStrictEqual(outcomes, [null]);
+    assert.strictEqual(watch.sent.length, 2);
+    done();
+  }, 300);
+});
+
+test("replaces queued weather and merges queued settings", function (port, done) {
+  var watch = scriptedWatch([]);
+  var outbox = outboxFor(watch);
+  var outcomes = {};
+  function record(name) {
+    return function (error) {
+      outcomes[name] = error ? error.message : "sent";
+    };
+  }
+  outbox.replace("weather", { WEATHER: [1] }, record("first"));
+  outbox.replace("weather", { WEATHER: [2] }, record("stale"));
+  outbox.merge("config", { ACCENT_COLOUR: 1, STEP_GOAL: 8000 }, record("save1"));
+  outbox.replace("weather", { WEATHER: [3] }, record("fresh"));
+  outbox.merge("config", { ACCENT_COLOUR: 2 }, record("save2"));
+  // Everything after the first message queued behind it; answer them all.
+  (function drain() {
+    if (Object.keys(outcomes).length === 5) {
+      assert.deepStrictEqual(watch.sent, [
+        { WEATHER: [1] },
+        { WEATHER: [3] },
+        { ACCENT_COLOUR: 2, STEP_GOAL: 8000 },
+      ]);
+      assert.deepStrictEqual(outcomes, { stale: "superseded", first: "sent", fresh: "sent", save1: "sent", save2: "sent" });
+      done();
+      return;
+    }
+    var ack = watch.held.shift();
+    if (ack) {
+      ack();
+    }
+    setTimeout(drain, 5);
+  })();
+});
+
+test("keeps unsent settings when a newer save is queued during a retry", function (port, done) {
+  var watch = scriptedWatch(["nack", "ack"]);
+  var outbox = outboxFor(watch);
+  var outcomes = [];
+  outbox.merge("config", { ACCENT_COLOUR: 1, STEP_GOAL: 8000 }, function (error) {
+    outcomes.push(error);
+  });
+  outbox.merge("config", { ACCENT_COLOUR: 2 }, function (error) {
+    outcomes.push(error);
+    assert.deepStrictEqual(watch.sent[1], { ACCENT_COLOUR: 2, STEP_GOAL: 8000 });
+    assert.deepStrictEqual(outcomes, [null, null]);
+    done();
+  });
+});
+
+// SavedPlaces on a clock the test moves, fetching a fixed reading for any
+// cell; sendError, when set, fails the next send with it.
+// Places fetch with the clock's time unless fallbackAgeMs makes them the
+// last good reading from that long ago.
+function placesFor(clock) {
+  var places = { fetched: [], sent: [], sendError: null, fallbackAgeMs: 0 };
+  places.saved = new SavedPlaces({
+    fetchForecast: function (cell, settings, result) {
+      places.fetched.push(cell);
+      var fetchedAt = clock.now - places.fallbackAgeMs;
+      setTimeout(function () {
+        result({ temperature: 10, high: 14, low: 4, conditions: 1, fetchedAt: fetchedAt });
+      }, 1);
+    },
+    send: function (table, done) {
+      var error = places.sendError;
+      places.sendError = null;
+      places.sent.push(table.map(function (place) {
+        return place.name;
+      }));
+      setTimeout(function () {
+        done(error);
+      }, 1);
+    },
+    now: function () {
+      return clock.now;
+    },
+  });
+  return places;
+}
+
+// Runs refresh() at each minute in turn, collecting what it fetched.
+function refreshAt(places, clock, settings, minutes, done) {
+  var fetches = [];
+  (function next(i) {
+    if (i === minutes.length) {
+      done(fetches);
+      return;
+    }
+    clock.now = minutes[i] * 60 * 1000;
+    var before = places.fetched.length;
+    places.saved.refresh(settings, function () {
+      fetches.push(places.fetched.length - before);
+      next(i + 1);
+    });
+  })(0);
+}
+
+var PLACES_SETTINGS = { UNITS: "C", SAVED_PLACES: "Home: 43.45, -80.49; Work: 43.47,-80.54 ; bad; Cottage: 45.1, -79.3" };
+
+test("fetches new places at once, then the stalest due place per refresh", function (port, done) {
+  storage = {};
+  var clock = { now: 0 };
+  var places = placesFor(clock);
+  refreshAt(places, clock, PLACES_SETTINGS, [0, 30, 61, 62, 63, 64], function (fetches) {
+    assert.deepStrictEqual(fetches, [3, 0, 1, 1, 1, 0]);
+    assert.deepStrictEqual(places.fetched.slice(3), ["43.45,-80.49", "43.47,-80.54", "45.10,-79.30"]);
+    assert.strictEqual(places.sent.length, 4);
+    assert.deepStrictEqual(places.sent[0], ["Home", "Work", "Cottage"]);
+    done();
+  });
+});
+
+test("keeps the fetch time of a fallback reading and retries it", function (port, done) {
+  storage = {};
+  var clock = { now: 0 };
+  var places = placesFor(clock);
+  var home = { UNITS: "C", SAVED_PLACES: "Home: 43.45, -80.49" };
+  places.fallbackAgeMs = 5 * 60 * 60 * 1000;
+  refreshAt(places, clock, home, [600], function (fetches) {
+    var entry = JSON.parse(storage["places-state"]).fetched["43.45,-80.49|C"];
+    assert.strictEqual(entry.at, 5 * 60 * 60 * 1000);
+    places.fallbackAgeMs = 0;
+    refreshAt(places, clock, home, [601], function (retries) {
+      assert.deepStrictEqual(fetches.concat(retries), [1, 1]);
+      done();
+    });
+  });
+});
+
+test("resends the table after a failed send and when a place is removed", function (port, done) {
+  storage = {};
+  var clock = { now: 0 };
+  var places = placesFor(clock);
+  places.sendError = new Error("nack");
+  refreshAt(places, clock, PLACES_SETTINGS, [0, 1, 2], function (fetches) {
+    assert.deepStrictEqual(fetches, [3, 0, 0]);
+    assert.strictEqual(places.sent.length, 2);
+    var fewer = { UNITS: "C", SAVED_PLACES: "Work: 43.47, -80.54" };
+    refreshAt(places, clock, fewer, [3], function (fetches) {
+      assert.deepStrictEqual(fetches, [0]);
+      assert.deepStrictEqual(places.sent[2], ["Work"]);
+      done();
+    });
+  });
+});
+
+// A SettingsSync whose watch answers each send with the next entry of
+// replies, null for an ACK.
+function settingsSyncFor(replies) {
+  var sync = { sent: [], refetches: 0 };
+  sync.settings = new settings.SettingsSync({
+    messageKeys: { UNITS: 10012, STEP_GOAL: 10020 },
+    send: function (delta, done) {
+      sync.sent.push(delta);
+      done(replies.shift() || null);
+    },
+    refetch: function () {
+      sync.refetches++;
+    },
+  });
+  return sync;
+}
+
+test("reports only the settings that changed since the last acknowledgement", function (port, done) {
+  storage = {};
+  assert.deepStrictEqual(settings.changed({ STEP_GOAL: 8000, UNITS: "C" }), { STEP_GOAL: 8000, UNITS: "C" });
+  settings.acknowledge({ STEP_GOAL: 8000, UNITS: "C" });
+  assert.deepStrictEqual(settings.changed({ STEP_GOAL: 8000, UNITS: "F" }), { UNITS: "F" });
+  assert.deepStrictEqual(settings.changed({ STEP_GOAL: 8000, UNITS: "C" }), {});
+  done();
+});
+
+test("sends only watch settings and acknowledges them on an ACK", function (port, done) {
+  storage = {};
+  var sync = settingsSyncFor([]);
+  sync.settings.save({ STEP_GOAL: 8000, WEATHER_CACHE_MINUTES: "30", 10012: "C" });
+  assert.deepStrictEqual(sync.sent, [{ STEP_GOAL: 8000 }]);
+  sync.settings.save({ STEP_GOAL: 8000, WEATHER_CACHE_MINUTES: "30", 10012: "C" });
+  assert.strictEqual(sync.sent.length, 1);
+  done();
+});
+
+test("resends settings the watch did not acknowledge", function (port, done) {
+  storage = {};
+  var sync = settingsSyncFor([new Error("nack")]);
+  sync.settings.save({ STEP_GOAL: 8000, ACCENT_COLOUR: 1 });
+  assert.deepStrictEqual(settings.changed({ STEP_GOAL: 8000, ACCENT_COLOUR: 1 }), { STEP_GOAL: 8000, ACCENT_COLOUR: 1 });
+  sync.settings.save({ STEP_GOAL: 8000, ACCENT_COLOUR: 2 });
+  assert.deepStrictEqual(sync.sent[1], { STEP_GOAL: 8000, ACCENT_COLOUR: 2 });
+  assert.deepStrictEqual(settings.changed({ STEP_GOAL: 8000, ACCENT_COLOUR: 2 }), {});
+  done();
+});
+
+test("refetches weather only when a weather input changes", function (port, done) {
+  storage = {};
+  var sync = settingsSyncFor([]);
+  var saved = { STEP_GOAL: 8000, WEATHER_CACHE_MINUTES: "30" };
+  sync.settings.save(saved);
+  saved.STEP_GOAL = 9000;
+  saved.WEATHER_CACHE_MINUTES = "10";
+  sync.settings.save(saved);
+  assert.strictEqual(sync.refetches, 0);
+  ["UNITS", "OWM_API_KEY", "LOCATION_NAME", "SAVED_PLACES"].forEach(function (key, i) {
+    saved[key] = "value " + i;
+    sync.settings.save(saved);
+    assert.strictEqual(sync.refetches, i + 1, key);
+  });
+  // By numeric message key, as Clay may report it.
+  saved[10012] = "F";
+  sync.settings.save(saved);
+  assert.strictEqual(sync.refetches, 5);
+  assert.strictEqual(sync.sent.length, 2);
+  done();
+});
+
+server.listen(0, "127.0.0.1", function () {
+  var port = server.address().port;
+  var failures = 0;
+  (function next(i) {
+    if (i === tests.length) {
+      server.close();
+      process.exitCode = failures ? 1 : 0;
+      return;
+    }
+    var finished = false;
+    function finish(error) {
+      if (finished) {
+        return;
+      }
+      finished = true;
+      console.log((error ? "FAIL " : "ok   ") + tests[i].name + (error ? ": " + error.message : ""));
+      failures += error ? 1 : 0;
+      // Let slow mock responses from this test drain before the next one.
+      setTimeout(function () {
+        next(i + 1);
+      }, 100);
+    }
+    process.removeAllListeners("uncaughtException");
+    process.on("uncaughtException", finish);
+    try {
+      tests[i].run(port, function () {
+        finish(null);
+      });
+    } catch (e) {
+      finish(e);
+    }
+  })(0);
+});
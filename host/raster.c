@@ -0,0 +1,507 @@
+// Software rasterizer for the stub; see raster.h.
+#include "raster.h"
+
+#include <math.h>
+#include <png.h>
+#include <stdlib.h>
+
+static bool s_enabled;
+
+static RasterOwnerStats s_owners[RASTER_MAX_OWNERS];
+static int s_owner_count;
+static RasterOwnerStats *s_owner;
+
+// The owner call and the frame that last wrote each pixel, for counting
+// distinct pixels without clearing a buffer between calls.
+static uint32_t s_call_stamps[PBL_DISPLAY_WIDTH * PBL_DISPLAY_HEIGHT];
+static uint32_t s_frame_stamps[PBL_DISPLAY_WIDTH * PBL_DISPLAY_HEIGHT];
+static uint32_t s_call;
+static uint32_t s_frame;
+static uint64_t s_frame_touched;
+
+void raster_enable(void)
+{
+  s_enabled = true;
+}
+
+bool raster_enabled(void)
+{
+  return s_enabled;
+}
+
+void raster_begin_frame(void)
+{
+  s_frame++;
+}
+
+void raster_begin_owner(const char *owner)
+{
+  s_owner = NULL;
+  for (int i = 0; i < s_owner_count; i++)
+  {
+    if (strcmp(s_owners[i].owner, owner) == 0)
+    {
+      s_owner = &s_owners[i];
+    }
+  }
+  if (!s_owner)
+  {
+    if (s_owner_count == RASTER_MAX_OWNERS)
+    {
+      fprintf(stderr, "raster: out of owners\n");
+      abort();
+    }
+    s_owner = &s_owners[s_owner_count++];
+    s_owner->owner = owner;
+  }
+  s_owner->calls++;
+  s_call++;
+}
+
+const RasterOwnerStats *raster_owner_stats(int *count)
+{
+  *count = s_owner_count;
+  return s_owners;
+}
+
+void raster_frame_stats(uint32_t *frames, uint64_t *touched)
+{
+  *frames = s_frame;
+  *touched = s_frame_touched;
+}
+
+// Pixels
+
+static GRect intersect(GRect a, GRect b)
+{
+  const int16_t x0 = a.origin.x > b.origin.x ? a.origin.x : b.origin.x;
+  const int16_t y0 = a.origin.y > b.origin.y ? a.origin.y : b.origin.y;
+  const int16_t x1 = a.origin.x + a.size.w < b.origin.x + b.size.w ? a.origin.x + a.size.w : b.origin.x + b.size.w;
+  const int16_t y1 = a.origin.y + a.size.h < b.origin.y + b.size.h ? a.origin.y + a.size.h : b.origin.y + b.size.h;
+  return GRect(x0, y0, x1 > x0 ? x1 - x0 : 0, y1 > y0 ? y1 - y0 : 0);
+}
+
+// An approximation of how black and white displays show colours: dark ones
+// black, light ones white and the greys in between a 50% dither.
+static bool mono_white(GColor color, int x, int y)
+{
+  const int level = color.r + color.g + color.b;
+  return level >= 5 || (level >= 3 && (x + y) % 2 == 0);
+}
+
+// Callers have already clipped (x, y) to the frame buffer.
+static void plot(GBitmap *frame_buffer, int x, int y, GColor color)
+{
+  const int index = y * PBL_DISPLAY_WIDTH + x;
+  if (s_owner)
+  {
+    s_owner->writes++;
+    if (s_call_stamps[index] != s_call)
+    {
+      s_call_stamps[index] = s_call;
+      s_owner->touched++;
+    }
+  }
+  if (s_frame_stamps[index] != s_frame)
+  {
+    s_frame_stamps[index] = s_frame;
+    s_frame_touched++;
+  }
+
+  uint8_t *row = gbitmap_get_data(frame_buffer) + y * gbitmap_get_bytes_per_row(frame_buffer);
+  if (gbitmap_get_format(frame_buffer) == GBitmapFormat8Bit)
+  {
+    row[x] = color.argb;
+  }
+  else if (mono_white(color, x, y))
+  {
+    row[x / 8] |= 1 << (x % 8);
+  }
+  else
+  {
+    row[x / 8] &= ~(1 << (x % 8));
+  }
+}
+
+static GRect drawable(const GBitmap *frame_buffer, GRect clip, GRect rect)
+{
+  return intersect(intersect(gbitmap_get_bounds(frame_buffer), clip), rect);
+}
+
+// Shapes
+
+void raster_fill_rect(GBitmap *frame_buffer, GRect clip, GRect rect, GColor color)
+{
+  if (!color.a)
+  {
+    return;
+  }
+  const GRect area = drawable(frame_buffer, clip, rect);
+  for (int y = area.origin.y; y < area.origin.y + area.size.h; y++)
+  {
+    for (int x = area.origin.x; x < area.origin.x + area.size.w; x++)
+    {
+      plot(frame_buffer, x, y, color);
+    }
+  }
+}
+
+void raster_fill_circle(GBitmap *frame_buffer, GRect clip, GPoint center, uint16_t radius, GColor color)
+{
+  if (!color.a)
+  {
+    return;
+  }
+  const GRect area = drawable(frame_buffer, clip, GRect(center.x - radius, center.y - radius, 2 * radius + 1, 2 * radius + 1));
+  for (int y = area.origin.y; y < area.origin.y + area.size.h; y++)
+  {
+    for (int x = area.origin.x; x < area.origin.x + area.size.w; x++)
+    {
+      const int dx = x - center.x;
+      const int dy = y - center.y;
+      if (dx * dx + dy * dy <= radius * radius + radius)
+      {
+        plot(frame_buffer, x, y, color);
+      }
+    }
+  }
+}
+
+// GOvalScaleModeFitCircle: the largest circle centred in rect.
+void raster_fill_radial(GBitmap *frame_buffer, GRect clip, GRect rect, uint16_t inset, int32_t angle_start, int32_t angle_end, GColor color)
+{
+  if (!color.a || !inset || angle_end <= angle_start)
+  {
+    return;
+  }
+  const double diameter = rect.size.w < rect.size.h ? rect.size.w : rect.size.h;
+  const double cx = rect.origin.x + rect.size.w / 2.0;
+  const double cy = rect.origin.y + rect.size.h / 2.0;
+  const double outer = diameter / 2;
+  const double inner = outer > inset ? outer - inset : 0;
+  const bool full = angle_end - angle_start >= TRIG_MAX_ANGLE;
+  const int32_t start = ((angle_start % TRIG_MAX_ANGLE) + TRIG_MAX_ANGLE) % TRIG_MAX_ANGLE;
+  const int32_t end = start + (angle_end - angle_start);
+
+  const GRect area = drawable(frame_buffer, clip, rect);
+  for (int y = area.origin.y; y < area.origin.y + area.size.h; y++)
+  {
+    for (int x = area.origin.x; x < area.origin.x + area.size.w; x++)
+    {
+      const double px = x + 0.5 - cx;
+      const double py = y + 0.5 - cy;
+      const double distance = px * px + py * py;
+      if (distance > outer * outer || distance < inner * inner)
+      {
+        continue;
+      }
+      if (!full)
+      {
+        double radians = atan2(px, -py);
+        if (radians < 0)
+        {
+          radians += 2 * M_PI;
+        }
+        const int32_t angle = (int32_t)(radians * TRIG_MAX_ANGLE / (2 * M_PI));
+        if (!(angle >= start && angle < end) && !(angle + TRIG_MAX_ANGLE >= start && angle + TRIG_MAX_ANGLE < end))
+        {
+          continue;
+        }
+      }
+      plot(frame_buffer, x, y, color);
+    }
+  }
+}
+
+#define RASTER_MAX_POLYGON_POINTS 32
+
+static int compare_double(const void *a, const void *b)
+{
+  const double x = *(const double *)a;
+  const double y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+// Even-odd fill, one scanline through each row of pixel centres.
+void raster_fill_polygon(GBitmap *frame_buffer, GRect clip, const GPoint *points, uint32_t count, GPoint offset, GColor color)
+{
+  if (!color.a || count < 3 || count > RASTER_MAX_POLYGON_POINTS)
+  {
+    return;
+  }
+  int16_t top = points[0].y;
+  int16_t bottom = points[0].y;
+  for (uint32_t i = 1; i < count; i++)
+  {
+    top = points[i].y < top ? points[i].y : top;
+    bottom = points[i].y > bottom ? points[i].y : bottom;
+  }
+  const GRect area = drawable(frame_buffer, clip, GRect(INT16_MIN / 2, offset.y + top, INT16_MAX, bottom - top + 1));
+  for (int y = area.origin.y; y < area.origin.y + area.size.h; y++)
+  {
+    const double scan = y + 0.5 - offset.y;
+    double crossings[RASTER_MAX_POLYGON_POINTS];
+    int crossing_count = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+      const GPoint a = points[i];
+      const GPoint b = points[(i + 1) % count];
+      if ((a.y <= scan) != (b.y <= scan))
+      {
+        crossings[crossing_count++] = offset.x + a.x + (scan - a.y) * (b.x - a.x) / (b.y - a.y);
+      }
+    }
+    qsort(crossings, crossing_count, sizeof(crossings[0]), compare_double);
+    for (int i = 0; i + 1 < crossing_count; i += 2)
+    {
+      const int x0 = (int)ceil(crossings[i] - 0.5);
+      const int x1 = (int)ceil(crossings[i + 1] - 0.5);
+      for (int x = x0 < area.origin.x ? area.origin.x : x0; x < x1 && x < area.origin.x + area.size.w; x++)
+      {
+        plot(frame_buffer, x, y, color);
+      }
+    }
+  }
+}
+
+// Bitmaps
+
+// Like the SDK, a bitmap smaller than rect is tiled across it. GCompOpSet
+// skips transparent pixels, or black ones in a 1-bit bitmap.
+void raster_draw_bitmap(GBitmap *frame_buffer, GRect clip, const GBitmap *bitmap, GRect rect, GCompOp mode)
+{
+  const GRect source = gbitmap_get_bounds(bitmap);
+  if (!source.size.w || !source.size.h)
+  {
+    return;
+  }
+  const uint8_t *data = gbitmap_get_data(bitmap);
+  const uint16_t stride = gbitmap_get_bytes_per_row(bitmap);
+  const bool color = gbitmap_get_format(bitmap) == GBitmapFormat8Bit;
+  const GRect area = drawable(frame_buffer, clip, rect);
+  for (int y = area.origin.y; y < area.origin.y + area.size.h; y++)
+  {
+    const uint8_t *row = data + (source.origin.y + (y - rect.origin.y) % source.size.h) * stride;
+    for (int x = area.origin.x; x < area.origin.x + area.size.w; x++)
+    {
+      const int sx = source.origin.x + (x - rect.origin.x) % source.size.w;
+      GColor pixel;
+      if (color)
+      {
+        pixel.argb = row[sx];
+      }
+      else
+      {
+        pixel = (row[sx / 8] & (1 << (sx % 8))) ? GColorWhite : GColorBlack;
+      }
+      if (mode == GCompOpSet && (color ? !pixel.a : pixel.argb == GColorBlackARGB8))
+      {
+        continue;
+      }
+      plot(frame_buffer, x, y, pixel);
+    }
+  }
+}
+
+// Text
+
+typedef struct
+{
+  uint32_t code;
+  // Five rows of three pixels, top to bottom.
+  const char *rows;
+} Glyph;
+
+static const Glyph GLYPHS[] = {
+    {' ', "000000000000000"}, {'0', "111101101101111"}, {'1', "010110010010111"},
+    {'2', "111001111100111"}, {'3', "111001111001111"}, {'4', "101101111001001"},
+    {'5', "111100111001111"}, {'6', "111100111101111"}, {'7', "111001001001001"},
+    {'8', "111101111101111"}, {'9', "111101111001111"}, {'A', "010101111101101"},
+    {'B', "110101110101110"}, {'C', "011100100100011"}, {'D', "110101101101110"},
+    {'E', "111100110100111"}, {'F', "111100110100100"}, {'G', "011100101101011"},
+    {'H', "101101111101101"}, {'I', "111010010010111"}, {'J', "001001001101010"},
+    {'K', "101101110101101"}, {'L', "100100100100111"}, {'M', "101111111101101"},
+    {'N', "110101101101101"}, {'O', "010101101101010"}, {'P', "110101110100100"},
+    {'Q', "010101101110011"}, {'R', "110101110101101"}, {'S', "011100010001110"},
+    {'T', "111010010010010"}, {'U', "101101101101111"}, {'V', "101101101101010"},
+    {'W', "101101111111101"}, {'X', "101101010101101"}, {'Y', "101101010010010"},
+    {'Z', "111001010100111"}, {':', "000010000010000"}, {'-', "000000111000000"},
+    {'.', "000000000000010"}, {'%', "101001010100101"}, {'/', "001001010100100"},
+    {0xb0, "111101111000000"},
+};
+
+// Anything without a glyph is drawn as a solid box.
+static const char *glyph_rows(uint32_t code)
+{
+  if (code >= 'a' && code <= 'z')
+  {
+    code -= 'a' - 'A';
+  }
+  for (size_t i = 0; i < ARRAY_LENGTH(GLYPHS); i++)
+  {
+    if (GLYPHS[i].code == code)
+    {
+      return GLYPHS[i].rows;
+    }
+  }
+  return "111111111111111";
+}
+
+static uint32_t next_codepoint(const char **text)
+{
+  const uint8_t *p = (const uint8_t *)*text;
+  uint32_t code = *p++;
+  int extra = code >= 0xf0 ? 3 : code >= 0xe0 ? 2 : code >= 0xc0 ? 1 : 0;
+  code &= extra ? 0x3f >> extra : 0x7f;
+  while (extra-- && (*p & 0xc0) == 0x80)
+  {
+    code = code << 6 | (*p++ & 0x3f);
+  }
+  *text = (const char *)p;
+  return code;
+}
+
+// One line, no wrapping: what does not fit the box is clipped.
+void raster_draw_text(GBitmap *frame_buffer, GRect clip, const char *text, int16_t font_size, GRect box, GTextAlignment alignment, GColor color)
+{
+  if (!color.a)
+  {
+    return;
+  }
+  const int scale = font_size / 9 > 1 ? font_size / 9 : 1;
+  const int advance = 4 * scale;
+  int length = 0;
+  for (const char *p = text; *p && *p != '\n'; length++)
+  {
+    next_codepoint(&p);
+  }
+  const int width = length * advance - scale;
+  int x = box.origin.x;
+  if (alignment == GTextAlignmentCenter)
+  {
+    x += (box.size.w - width) / 2;
+  }
+  else if (alignment == GTextAlignmentRight)
+  {
+    x += box.size.w - width;
+  }
+  const int top = box.origin.y + (font_size - 5 * scale) / 2;
+
+  const GRect area = drawable(frame_buffer, clip, box);
+  const char *p = text;
+  for (int i = 0; i < length; i++, x += advance)
+  {
+    const char *rows = glyph_rows(next_codepoint(&p));
+    for (int cell = 0; cell < 15; cell++)
+    {
+      if (rows[cell] != '1')
+      {
+        continue;
+      }
+      const GRect block = intersect(area, GRect(x + cell % 3 * scale, top + cell / 3 * scale, scale, scale));
+      for (int y = block.origin.y; y < block.origin.y + block.size.h; y++)
+      {
+        for (int bx = block.origin.x; bx < block.origin.x + block.size.w; bx++)
+        {
+          plot(frame_buffer, bx, y, color);
+        }
+      }
+    }
+  }
+}
+
+// PNG snapshots
+
+static uint8_t *to_rgb(const GBitmap *frame_buffer)
+{
+  const GRect bounds = gbitmap_get_bounds(frame_buffer);
+  const uint8_t *data = gbitmap_get_data(frame_buffer);
+  const uint16_t stride = gbitmap_get_bytes_per_row(frame_buffer);
+  uint8_t *rgb = malloc(bounds.size.w * bounds.size.h * 3);
+  for (int y = 0; y < bounds.size.h; y++)
+  {
+    for (int x = 0; x < bounds.size.w; x++)
+    {
+      uint8_t *out = &rgb[(y * bounds.size.w + x) * 3];
+      if (gbitmap_get_format(frame_buffer) == GBitmapFormat8Bit)
+      {
+        const GColor pixel = {.argb = data[y * stride + x]};
+        out[0] = pixel.r * 85;
+        out[1] = pixel.g * 85;
+        out[2] = pixel.b * 85;
+      }
+      else
+      {
+        memset(out, data[y * stride + x / 8] & (1 << (x % 8)) ? 255 : 0, 3);
+      }
+    }
+  }
+  return rgb;
+}
+
+static bool write_rgb(const char *path, const uint8_t *rgb, GSize size)
+{
+  png_image image = {
+      .version = PNG_IMAGE_VERSION,
+      .width = size.w,
+      .height = size.h,
+      .format = PNG_FORMAT_RGB,
+  };
+  return png_image_write_to_file(&image, path, 0, rgb, 0, NULL);
+}
+
+bool raster_write_png(const GBitmap *frame_buffer, const char *path)
+{
+  uint8_t *rgb = to_rgb(frame_buffer);
+  const bool written = write_rgb(path, rgb, gbitmap_get_bounds(frame_buffer).size);
+  free(rgb);
+  return written;
+}
+
+int raster_compare_png(const GBitmap *frame_buffer, const char *path, const char *diff_path)
+{
+  const GSize size = gbitmap_get_bounds(frame_buffer).size;
+  png_image image = {.version = PNG_IMAGE_VERSION};
+  if (!png_image_begin_read_from_file(&image, path))
+  {
+    return -1;
+  }
+  if (image.width != (png_uint_32)size.w || image.height != (png_uint_32)size.h)
+  {
+    png_image_free(&image);
+    return -1;
+  }
+  image.format = PNG_FORMAT_RGB;
+  uint8_t *golden = malloc(PNG_IMAGE_SIZE(image));
+  if (!png_image_finish_read(&image, NULL, golden, 0, NULL))
+  {
+    free(golden);
+    return -1;
+  }
+
+  uint8_t *rgb = to_rgb(frame_buffer);
+  int differing = 0;
+  for (int i = 0; i < size.w * size.h; i++)
+  {
+    if (memcmp(&rgb[i * 3], &golden[i * 3], 3) != 0)
+    {
+      differing++;
+      // Dimmed frame, differing pixels in red.
+      golden[i * 3] = 255;
+      golden[i * 3 + 1] = golden[i * 3 + 2] = 0;
+    }
+    else
+    {
+      golden[i * 3] /= 3;
+      golden[i * 3 + 1] /= 3;
+      golden[i * 3 + 2] /= 3;
+    }
+  }
+  if (differing && diff_path)
+  {
+    write_rgb(diff_path, golden, size);
+  }
+  free(rgb);
+  free(golden);
+  return differing;
+}
@@ -0,0 +1,53 @@
+// Software rasterizer behind the stub's drawing calls, for golden frames and
+// overdraw accounting. It stays off unless raster_enable() is called, so the
+// timing scenarios only pay for the counters.
+//
+// Shapes are sampled at pixel centres; radial fills follow the SDK's angles
+// (0 at twelve o'clock, clockwise). Text is drawn with a scaled 3x5 block
+// font sized from the font's point size, clipped to its box: good enough to
+// see a label move, change or overflow, not to judge typography.
+#pragma once
+
+#include "pebble.h"
+
+void raster_enable(void);
+bool raster_enabled(void);
+
+// Pixels written from here to the next raster_begin_owner() are charged to
+// owner, which is kept by reference. raster_begin_frame() starts a frame for
+// the per-frame totals.
+void raster_begin_frame(void);
+void raster_begin_owner(const char *owner);
+
+// Every primitive takes absolute screen coordinates and a clip rect, also in
+// screen coordinates.
+void raster_fill_rect(GBitmap *frame_buffer, GRect clip, GRect rect, GColor color);
+void raster_fill_circle(GBitmap *frame_buffer, GRect clip, GPoint center, uint16_t radius, GColor color);
+void raster_fill_radial(GBitmap *frame_buffer, GRect clip, GRect rect, uint16_t inset, int32_t angle_start, int32_t angle_end, GColor color);
+void raster_fill_polygon(GBitmap *frame_buffer, GRect clip, const GPoint *points, uint32_t count, GPoint offset, GColor color);
+void raster_draw_bitmap(GBitmap *frame_buffer, GRect clip, const GBitmap *bitmap, GRect rect, GCompOp mode);
+void raster_draw_text(GBitmap *frame_buffer, GRect clip, const char *text, int16_t font_size, GRect box, GTextAlignment alignment, GColor color);
+
+// Writes for each owner against the distinct pixels it touched in the same
+// call; writes / touched is its overdraw ratio.
+typedef struct
+{
+  const char *owner;
+  uint32_t calls;
+  uint64_t writes;
+  uint64_t touched;
+} RasterOwnerStats;
+
+#define RASTER_MAX_OWNERS 16
+
+const RasterOwnerStats *raster_owner_stats(int *count);
+
+// Frames drawn and the distinct pixels written in each, summed.
+void raster_frame_stats(uint32_t *frames, uint64_t *touched);
+
+// PNG snapshots. raster_compare_png() returns the number of pixels that
+// differ from the image at path, or -1 if it cannot be read or has another
+// size; when diff_path is given and pixels differ, it writes the frame with
+// the differing pixels in red.
+bool raster_write_png(const GBitmap *frame_buffer, const char *path);
+int raster_compare_png(const GBitmap *frame_buffer, const char *path, const char *diff_path);
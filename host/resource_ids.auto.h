@@ -0,0 +1,7 @@
+// Mirrors the resource IDs the SDK generates from the media list in
+// package.json. Keep the order in sync.
+#pragma once
+
+#define RESOURCE_ID_FONT_TOMORROW_62 1
+#define RESOURCE_ID_FONT_TOMORROW_45 2
+#define RESOURCE_ID_WEATHER_ICONS 3
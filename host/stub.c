@@ -0,0 +1,1736 @@
+// Host implementation of the SDK subset declared in pebble.h.
+#include "stub.h"
+
+#include "raster.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdlib.h>
+
+StubCounters stub_counters;
+
+// Probes
+
+static StubProbe s_probes[STUB_MAX_PROBES];
+static int s_probe_count;
+
+static StubProbe *probe_for(const void *fn)
+{
+  for (int i = 0; i < s_probe_count; i++)
+  {
+    if (s_probes[i].fn == fn)
+    {
+      return &s_probes[i];
+    }
+  }
+  if (s_probe_count == STUB_MAX_PROBES)
+  {
+    fprintf(stderr, "stub: out of probes\n");
+    abort();
+  }
+  StubProbe *probe = &s_probes[s_probe_count++];
+  probe->fn = fn;
+  return probe;
+}
+
+void stub_probe_name(const void *fn, const char *name)
+{
+  probe_for(fn)->name = name;
+}
+
+const StubProbe *stub_probes(int *count)
+{
+  *count = s_probe_count;
+  return s_probes;
+}
+
+// App heap
+
+// App RAM per platform. The app binary and its statics come out of the same
+// budget on the watch, so heap_bytes_free() here overstates the headroom.
+#if defined(PBL_PLATFORM_APLITE)
+#define STUB_APP_RAM (24 * 1024)
+#elif defined(PBL_PLATFORM_EMERY)
+#define STUB_APP_RAM (128 * 1024)
+#else
+#define STUB_APP_RAM (64 * 1024)
+#endif
+
+typedef union
+{
+  size_t size;
+  max_align_t align;
+} HeapHeader;
+
+static size_t s_heap_used;
+static size_t s_heap_peak;
+
+static void heap_charge(size_t size)
+{
+  s_heap_used += size;
+  if (s_heap_used > s_heap_peak)
+  {
+    s_heap_peak = s_heap_used;
+  }
+}
+
+// Every object the SDK allocates on the app's behalf goes through here, so
+// the totals track what the app would hold on the watch heap.
+static void *heap_alloc(size_t size)
+{
+  HeapHeader *header = calloc(1, sizeof(HeapHeader) + size);
+  header->size = size;
+  heap_charge(size);
+  return header + 1;
+}
+
+static void heap_free(void *ptr)
+{
+  if (!ptr)
+  {
+    return;
+  }
+  HeapHeader *header = (HeapHeader *)ptr - 1;
+  s_heap_used -= header->size;
+  free(header);
+}
+
+size_t heap_bytes_used(void)
+{
+  return s_heap_used;
+}
+
+size_t heap_bytes_free(void)
+{
+  return STUB_APP_RAM - s_heap_used;
+}
+
+size_t stub_heap_peak(void)
+{
+  return s_heap_peak;
+}
+
+void stub_heap_reset_peak(void)
+{
+  s_heap_peak = s_heap_used;
+}
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void probe_record(const void *fn, uint64_t start_ns)
+{
+  uint64_t elapsed = now_ns() - start_ns;
+  StubProbe *probe = probe_for(fn);
+  probe->calls++;
+  probe->total_ns += elapsed;
+  if (elapsed > probe->max_ns)
+  {
+    probe->max_ns = elapsed;
+  }
+}
+
+#define PROBE_CALL(fn, ...)         \
+  do                                \
+  {                                 \
+    uint64_t probe_start = now_ns(); \
+    fn(__VA_ARGS__);                \
+    probe_record((const void *)fn, probe_start); \
+  } while (0)
+
+// Clock and logging
+
+static time_t s_now;
+// Milliseconds past s_now, for app timers.
+static uint16_t s_now_ms;
+static bool s_24h_style = true;
+
+static void fire_timers(uint64_t until_ms);
+
+static uint64_t clock_ms(void)
+{
+  return (uint64_t)s_now * 1000 + s_now_ms;
+}
+
+static void set_clock_ms(uint64_t ms)
+{
+  s_now = ms / 1000;
+  s_now_ms = ms % 1000;
+}
+
+void stub_set_time(time_t now)
+{
+  fire_timers((uint64_t)now * 1000);
+  set_clock_ms((uint64_t)now * 1000);
+}
+
+void stub_advance_ms(uint32_t ms)
+{
+  const uint64_t until = clock_ms() + ms;
+  fire_timers(until);
+  set_clock_ms(until);
+}
+
+time_t stub_now(void)
+{
+  return s_now;
+}
+
+time_t stub_time(time_t *tloc)
+{
+  if (tloc)
+  {
+    *tloc = s_now;
+  }
+  return s_now;
+}
+
+uint16_t time_ms(time_t *t_utc, uint16_t *out_ms)
+{
+  uint16_t ms = (uint16_t)((now_ns() / 1000000ull) % 1000);
+  if (t_utc)
+  {
+    *t_utc = s_now;
+  }
+  if (out_ms)
+  {
+    *out_ms = ms;
+  }
+  return ms;
+}
+
+void stub_set_24h_style(bool is_24h)
+{
+  s_24h_style = is_24h;
+}
+
+bool clock_is_24h_style(void)
+{
+  return s_24h_style;
+}
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...)
+{
+  if (!getenv("STUB_VERBOSE"))
+  {
+    return;
+  }
+  va_list args;
+  va_start(args, fmt);
+  fprintf(stderr, "[%u] %s:%d ", log_level, src_filename, src_line_number);
+  vfprintf(stderr, fmt, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+// Geometry, colour and trig
+
+bool grect_equal(const GRect *const rect_a, const GRect *const rect_b)
+{
+  return memcmp(rect_a, rect_b, sizeof(GRect)) == 0;
+}
+
+bool gpoint_equal(const GPoint *const point_a, const GPoint *const point_b)
+{
+  return point_a->x == point_b->x && point_a->y == point_b->y;
+}
+
+bool gcolor_equal(GColor8 x, GColor8 y)
+{
+  return x.argb == y.argb;
+}
+
+GColor8 gcolor_legible_over(GColor8 background_color)
+{
+  // Same luminance split as the firmware: light backgrounds get black text.
+  int luma = background_color.r * 299 + background_color.g * 587 + background_color.b * 114;
+  return luma >= 1500 ? GColorBlack : GColorWhite;
+}
+
+int32_t sin_lookup(int32_t angle)
+{
+  return (int32_t)lround(sin(2 * M_PI * angle / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+int32_t cos_lookup(int32_t angle)
+{
+  return (int32_t)lround(cos(2 * M_PI * angle / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+// Resources, bitmaps and fonts
+
+struct GBitmap
+{
+  GRect bounds;
+  GBitmapFormat format;
+  uint16_t row_size;
+  uint8_t *data;
+  bool owns_data;
+};
+
+struct GFontStub
+{
+  const char *key;
+};
+
+ResHandle resource_get_handle(uint32_t resource_id)
+{
+  return (ResHandle)(uintptr_t)resource_id;
+}
+
+static GBitmapFormat native_format(void)
+{
+  return PBL_IF_COLOR_ELSE(GBitmapFormat8Bit, GBitmapFormat1Bit);
+}
+
+static uint16_t row_size_for(GBitmapFormat format, int16_t w)
+{
+  return format == GBitmapFormat8Bit ? w : ((w + 31) / 32) * 4;
+}
+
+GBitmap *gbitmap_create_blank(GSize size, GBitmapFormat format)
+{
+  GBitmap *bitmap = heap_alloc(sizeof(GBitmap));
+  bitmap->bounds = GRect(0, 0, size.w, size.h);
+  bitmap->format = format;
+  bitmap->row_size = row_size_for(format, size.w);
+  bitmap->data = heap_alloc(bitmap->row_size * (size.h ? size.h : 1));
+  bitmap->owns_data = true;
+  return bitmap;
+}
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id)
+{
+  stub_counters.resource_loads++;
+  // The only bitmap resource is the weather icon atlas: six 21x21 icons.
+  // Each gets a placeholder, an outline over a bar as tall as its index, so
+  // golden frames show which one is up.
+  GBitmap *atlas = gbitmap_create_blank(GSize(6 * 21, 21), native_format());
+  for (int16_t y = 0; y < 21; y++)
+  {
+    for (int16_t x = 0; x < 6 * 21; x++)
+    {
+      const int16_t icon_x = x % 21;
+      const bool edge = icon_x == 0 || icon_x == 20 || y == 0 || y == 20;
+      const bool bar = icon_x >= 8 && icon_x <= 12 && y >= 20 - 3 * (x / 21 + 1);
+      if (!edge && !bar)
+      {
+        continue;
+      }
+      if (atlas->format == GBitmapFormat8Bit)
+      {
+        atlas->data[y * atlas->row_size + x] = GColorWhiteARGB8;
+      }
+      else
+      {
+        atlas->data[y * atlas->row_size + x / 8] |= 1 << (x % 8);
+      }
+    }
+  }
+  return atlas;
+}
+
+GBitmap *gbitmap_create_as_sub_bitmap(const GBitmap *base_bitmap, GRect sub_rect)
+{
+  GBitmap *bitmap = heap_alloc(sizeof(GBitmap));
+  *bitmap = *base_bitmap;
+  bitmap->bounds = sub_rect;
+  bitmap->owns_data = false;
+  return bitmap;
+}
+
+void gbitmap_destroy(GBitmap *bitmap)
+{
+  if (!bitmap)
+  {
+    return;
+  }
+  if (bitmap->owns_data)
+  {
+    heap_free(bitmap->data);
+  }
+  heap_free(bitmap);
+}
+
+GRect gbitmap_get_bounds(const GBitmap *bitmap)
+{
+  return bitmap->bounds;
+}
+
+uint8_t *gbitmap_get_data(const GBitmap *bitmap)
+{
+  return bitmap->data;
+}
+
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap)
+{
+  return bitmap->row_size;
+}
+
+GBitmapFormat gbitmap_get_format(const GBitmap *bitmap)
+{
+  return bitmap->format;
+}
+
+GFont fonts_get_system_font(const char *font_key)
+{
+  static struct GFontStub system_fonts[8];
+  for (size_t i = 0; i < sizeof(system_fonts) / sizeof(system_fonts[0]); i++)
+  {
+    if (!system_fonts[i].key || strcmp(system_fonts[i].key, font_key) == 0)
+    {
+      system_fonts[i].key = font_key;
+      return &system_fonts[i];
+    }
+  }
+  return &system_fonts[0];
+}
+
+GFont fonts_load_custom_font(ResHandle handle)
+{
+  stub_counters.resource_loads++;
+  GFont font = heap_alloc(sizeof(struct GFontStub));
+  font->key = (uintptr_t)handle == RESOURCE_ID_FONT_TOMORROW_62 ? "RESOURCE_ID_FONT_TOMORROW_62" : "RESOURCE_ID_FONT_TOMORROW_45";
+  return font;
+}
+
+void fonts_unload_custom_font(GFont font)
+{
+  heap_free(font);
+}
+
+// Font keys carry the point size, as in RESOURCE_ID_GOTHIC_18_BOLD.
+static int16_t font_size(GFont font)
+{
+  const char *digits = font ? font->key : "";
+  while (*digits && !isdigit((unsigned char)*digits))
+  {
+    digits++;
+  }
+  return *digits ? atoi(digits) : 14;
+}
+
+// Graphics
+
+struct GContext
+{
+  GColor fill_color;
+  GColor stroke_color;
+  GColor text_color;
+  uint8_t stroke_width;
+  GCompOp compositing_mode;
+  GPoint offset;
+  // The drawing layer's frame on screen, cut to its ancestors'.
+  GRect clip;
+  GBitmap *frame_buffer;
+};
+
+static GContext s_ctx;
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color)
+{
+  ctx->fill_color = color;
+}
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color)
+{
+  ctx->stroke_color = color;
+}
+
+void graphics_context_set_text_color(GContext *ctx, GColor color)
+{
+  ctx->text_color = color;
+}
+
+void graphics_context_set_stroke_width(GContext *ctx, uint8_t stroke_width)
+{
+  ctx->stroke_width = stroke_width;
+}
+
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode)
+{
+  ctx->compositing_mode = mode;
+}
+
+static GRect to_screen(const GContext *ctx, GRect rect)
+{
+  return GRect(rect.origin.x + ctx->offset.x, rect.origin.y + ctx->offset.y, rect.size.w, rect.size.h);
+}
+
+// Corner radii are not drawn.
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask)
+{
+  stub_counters.graphics_fill_rect++;
+  if (raster_enabled())
+  {
+    raster_fill_rect(ctx->frame_buffer, ctx->clip, to_screen(ctx, rect), ctx->fill_color);
+  }
+}
+
+void graphics_fill_circle(GContext *ctx, GPoint p, uint16_t radius)
+{
+  stub_counters.graphics_fill_circle++;
+  if (raster_enabled())
+  {
+    raster_fill_circle(ctx->frame_buffer, ctx->clip, GPoint(p.x + ctx->offset.x, p.y + ctx->offset.y), radius, ctx->fill_color);
+  }
+}
+
+// Only GOvalScaleModeFitCircle is drawn; the face uses nothing else.
+void graphics_fill_radial(GContext *ctx, GRect rect, GOvalScaleMode scale_mode, uint16_t inset_thickness, int32_t angle_start, int32_t angle_end)
+{
+  stub_counters.graphics_fill_radial++;
+  if (raster_enabled())
+  {
+    raster_fill_radial(ctx->frame_buffer, ctx->clip, to_screen(ctx, rect), inset_thickness, angle_start, angle_end, ctx->fill_color);
+  }
+}
+
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect)
+{
+  stub_counters.graphics_draw_bitmap++;
+  if (raster_enabled())
+  {
+    raster_draw_bitmap(ctx->frame_buffer, ctx->clip, bitmap, to_screen(ctx, rect), ctx->compositing_mode);
+  }
+}
+
+void graphics_draw_text(GContext *ctx, const char *text, GFont const font, const GRect box, const GTextOverflowMode overflow_mode, const GTextAlignment alignment, void *text_attributes)
+{
+  stub_counters.graphics_draw_text++;
+  if (raster_enabled())
+  {
+    raster_draw_text(ctx->frame_buffer, ctx->clip, text, font_size(font), to_screen(ctx, box), alignment, ctx->text_color);
+  }
+}
+
+GBitmap *graphics_capture_frame_buffer(GContext *ctx)
+{
+  return ctx->frame_buffer;
+}
+
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer)
+{
+  return buffer == ctx->frame_buffer;
+}
+
+struct GPath
+{
+  GPathInfo info;
+  GPoint offset;
+};
+
+GPath *gpath_create(const GPathInfo *init)
+{
+  GPath *path = heap_alloc(sizeof(GPath));
+  path->info = *init;
+  return path;
+}
+
+void gpath_destroy(GPath *gpath)
+{
+  heap_free(gpath);
+}
+
+void gpath_move_to(GPath *path, GPoint point)
+{
+  path->offset = point;
+}
+
+void gpath_draw_filled(GContext *ctx, GPath *path)
+{
+  stub_counters.gpath_draw_filled++;
+  if (raster_enabled())
+  {
+    raster_fill_polygon(ctx->frame_buffer, ctx->clip, path->info.points, path->info.num_points,
+                        GPoint(path->offset.x + ctx->offset.x, path->offset.y + ctx->offset.y), ctx->fill_color);
+  }
+}
+
+// Layers
+
+typedef enum
+{
+  LayerKindPlain,
+  LayerKindText,
+  LayerKindBitmap,
+} LayerKind;
+
+struct Layer
+{
+  GRect frame;
+  LayerUpdateProc update_proc;
+  Layer *parent;
+  Layer *first_child;
+  Layer *next_sibling;
+  bool hidden;
+  LayerKind kind;
+  void *owner;
+  uint8_t data[];
+};
+
+struct TextLayer
+{
+  Layer *layer;
+  const char *text;
+  GFont font;
+  GColor text_color;
+  GColor background_color;
+  GTextAlignment alignment;
+  GTextOverflowMode overflow_mode;
+};
+
+struct BitmapLayer
+{
+  Layer *layer;
+  const GBitmap *bitmap;
+  GAlign alignment;
+  GCompOp compositing_mode;
+};
+
+struct Window
+{
+  Layer *root;
+  WindowHandlers handlers;
+  GColor background_color;
+  bool loaded;
+};
+
+static bool s_render_pending;
+static Window *s_top_window;
+
+static void mark_dirty(Layer *layer)
+{
+  s_render_pending = true;
+}
+
+Layer *layer_create_with_data(GRect frame, size_t data_size)
+{
+  Layer *layer = heap_alloc(sizeof(Layer) + data_size);
+  layer->frame = frame;
+  return layer;
+}
+
+Layer *layer_create(GRect frame)
+{
+  return layer_create_with_data(frame, 0);
+}
+
+void *layer_get_data(const Layer *layer)
+{
+  return (void *)layer->data;
+}
+
+void layer_remove_from_parent(Layer *child)
+{
+  Layer *parent = child->parent;
+  if (!parent)
+  {
+    return;
+  }
+  for (Layer **link = &parent->first_child; *link; link = &(*link)->next_sibling)
+  {
+    if (*link == child)
+    {
+      *link = child->next_sibling;
+      break;
+    }
+  }
+  child->parent = NULL;
+  child->next_sibling = NULL;
+  mark_dirty(parent);
+}
+
+void layer_destroy(Layer *layer)
+{
+  if (!layer)
+  {
+    return;
+  }
+  layer_remove_from_parent(layer);
+  heap_free(layer);
+}
+
+void layer_mark_dirty(Layer *layer)
+{
+  stub_counters.layer_mark_dirty++;
+  mark_dirty(layer);
+}
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc)
+{
+  layer->update_proc = update_proc;
+}
+
+void layer_set_frame(Layer *layer, GRect frame)
+{
+  layer->frame = frame;
+  mark_dirty(layer);
+}
+
+GRect layer_get_frame(const Layer *layer)
+{
+  return layer->frame;
+}
+
+GRect layer_get_bounds(const Layer *layer)
+{
+  return GRect(0, 0, layer->frame.size.w, layer->frame.size.h);
+}
+
+// Height covered at the bottom of the screen, by Timeline Quick View.
+static int16_t s_obstruction;
+
+GRect layer_get_unobstructed_bounds(const Layer *layer)
+{
+  GRect bounds = layer_get_bounds(layer);
+  int16_t top = 0;
+  for (const Layer *l = layer; l; l = l->parent)
+  {
+    top += l->frame.origin.y;
+  }
+  const int16_t visible = PBL_DISPLAY_HEIGHT - s_obstruction - top;
+  if (bounds.size.h > visible)
+  {
+    bounds.size.h = visible > 0 ? visible : 0;
+  }
+  return bounds;
+}
+
+void layer_set_hidden(Layer *layer, bool hidden)
+{
+  if (layer->hidden != hidden)
+  {
+    layer->hidden = hidden;
+    mark_dirty(layer);
+  }
+}
+
+bool layer_get_hidden(const Layer *layer)
+{
+  return layer->hidden;
+}
+
+void layer_add_child(Layer *parent, Layer *child)
+{
+  layer_remove_from_parent(child);
+  Layer **link = &parent->first_child;
+  while (*link)
+  {
+    link = &(*link)->next_sibling;
+  }
+  *link = child;
+  child->parent = parent;
+  mark_dirty(parent);
+}
+
+TextLayer *text_layer_create(GRect frame)
+{
+  TextLayer *text_layer = heap_alloc(sizeof(TextLayer));
+  text_layer->layer = layer_create(frame);
+  text_layer->layer->kind = LayerKindText;
+  text_layer->layer->owner = text_layer;
+  text_layer->text_color = GColorBlack;
+  text_layer->background_color = GColorWhite;
+  return text_layer;
+}
+
+void text_layer_destroy(TextLayer *text_layer)
+{
+  layer_destroy(text_layer->layer);
+  heap_free(text_layer);
+}
+
+Layer *text_layer_get_layer(TextLayer *text_layer)
+{
+  return text_layer->layer;
+}
+
+static void text_layer_mutated(TextLayer *text_layer)
+{
+  stub_counters.text_layer_mutations++;
+  mark_dirty(text_layer->layer);
+}
+
+void text_layer_set_text(TextLayer *text_layer, const char *text)
+{
+  text_layer->text = text;
+  text_layer_mutated(text_layer);
+}
+
+const char *text_layer_get_text(TextLayer *text_layer)
+{
+  return text_layer->text;
+}
+
+void text_layer_set_background_color(TextLayer *text_layer, GColor color)
+{
+  text_layer->background_color = color;
+  text_layer_mutated(text_layer);
+}
+
+void text_layer_set_text_color(TextLayer *text_layer, GColor color)
+{
+  text_layer->text_color = color;
+  text_layer_mutated(text_layer);
+}
+
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment text_alignment)
+{
+  text_layer->alignment = text_alignment;
+  text_layer_mutated(text_layer);
+}
+
+void text_layer_set_overflow_mode(TextLayer *text_layer, GTextOverflowMode line_mode)
+{
+  text_layer->overflow_mode = line_mode;
+  text_layer_mutated(text_layer);
+}
+
+void text_layer_set_font(TextLayer *text_layer, GFont font)
+{
+  text_layer->font = font;
+  text_layer_mutated(text_layer);
+}
+
+BitmapLayer *bitmap_layer_create(GRect frame)
+{
+  BitmapLayer *bitmap_layer = heap_alloc(sizeof(BitmapLayer));
+  bitmap_layer->layer = layer_create(frame);
+  bitmap_layer->layer->kind = LayerKindBitmap;
+  bitmap_layer->layer->owner = bitmap_layer;
+  return bitmap_layer;
+}
+
+void bitmap_layer_destroy(BitmapLayer *bitmap_layer)
+{
+  layer_destroy(bitmap_layer->layer);
+  heap_free(bitmap_layer);
+}
+
+Layer *bitmap_layer_get_layer(const BitmapLayer *bitmap_layer)
+{
+  return bitmap_layer->layer;
+}
+
+void bitmap_layer_set_bitmap(BitmapLayer *bitmap_layer, const GBitmap *bitmap)
+{
+  bitmap_layer->bitmap = bitmap;
+  mark_dirty(bitmap_layer->layer);
+}
+
+void bitmap_layer_set_alignment(BitmapLayer *bitmap_layer, GAlign alignment)
+{
+  bitmap_layer->alignment = alignment;
+  mark_dirty(bitmap_layer->layer);
+}
+
+void bitmap_layer_set_compositing_mode(BitmapLayer *bitmap_layer, GCompOp mode)
+{
+  bitmap_layer->compositing_mode = mode;
+  mark_dirty(bitmap_layer->layer);
+}
+
+Window *window_create(void)
+{
+  Window *window = heap_alloc(sizeof(Window));
+  window->root = layer_create(GRect(0, 0, PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT));
+  window->background_color = GColorWhite;
+  return window;
+}
+
+void window_destroy(Window *window)
+{
+  if (window->loaded && window->handlers.unload)
+  {
+    window->handlers.unload(window);
+  }
+  if (s_top_window == window)
+  {
+    s_top_window = NULL;
+  }
+  layer_destroy(window->root);
+  heap_free(window);
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers)
+{
+  window->handlers = handlers;
+}
+
+Layer *window_get_root_layer(const Window *window)
+{
+  return window->root;
+}
+
+void window_set_background_color(Window *window, GColor background_color)
+{
+  window->background_color = background_color;
+  mark_dirty(window->root);
+}
+
+void window_stack_push(Window *window, bool animated)
+{
+  s_top_window = window;
+  if (!window->loaded)
+  {
+    window->loaded = true;
+    if (window->handlers.load)
+    {
+      window->handlers.load(window);
+    }
+  }
+  if (window->handlers.appear)
+  {
+    window->handlers.appear(window);
+  }
+  mark_dirty(window->root);
+}
+
+// Compositor
+
+static GRect clip_to(GRect clip, GRect rect)
+{
+  const int16_t x0 = clip.origin.x > rect.origin.x ? clip.origin.x : rect.origin.x;
+  const int16_t y0 = clip.origin.y > rect.origin.y ? clip.origin.y : rect.origin.y;
+  const int16_t x1 = clip.origin.x + clip.size.w < rect.origin.x + rect.size.w ? clip.origin.x + clip.size.w : rect.origin.x + rect.size.w;
+  const int16_t y1 = clip.origin.y + clip.size.h < rect.origin.y + rect.size.h ? clip.origin.y + clip.size.h : rect.origin.y + rect.size.h;
+  return GRect(x0, y0, x1 > x0 ? x1 - x0 : 0, y1 > y0 ? y1 - y0 : 0);
+}
+
+// Pixels the rasterizer writes are charged to the update proc, under its
+// probe name, or to the built-in layer kind.
+static const char *layer_owner_name(const Layer *layer)
+{
+  switch (layer->kind)
+  {
+  case LayerKindText:
+    return "text_layer";
+  case LayerKindBitmap:
+    return "bitmap_layer";
+  case LayerKindPlain:
+    break;
+  }
+  const char *name = probe_for((const void *)layer->update_proc)->name;
+  return name ? name : "(unnamed)";
+}
+
+static void render_layer(Layer *layer, GPoint origin, GRect clip)
+{
+  if (layer->hidden)
+  {
+    return;
+  }
+  GPoint layer_origin = GPoint(origin.x + layer->frame.origin.x, origin.y + layer->frame.origin.y);
+  s_ctx.offset = layer_origin;
+  const GRect layer_clip = clip_to(clip, GRect(layer_origin.x, layer_origin.y, layer->frame.size.w, layer->frame.size.h));
+  s_ctx.clip = layer_clip;
+  if (raster_enabled() && (layer->kind != LayerKindPlain || layer->update_proc))
+  {
+    raster_begin_owner(layer_owner_name(layer));
+  }
+  switch (layer->kind)
+  {
+  case LayerKindText:
+  {
+    TextLayer *text_layer = layer->owner;
+    if (text_layer->background_color.a)
+    {
+      graphics_context_set_fill_color(&s_ctx, text_layer->background_color);
+      graphics_fill_rect(&s_ctx, layer_get_bounds(layer), 0, GCornerNone);
+    }
+    if (text_layer->text && text_layer->text[0])
+    {
+      graphics_context_set_text_color(&s_ctx, text_layer->text_color);
+      graphics_draw_text(&s_ctx, text_layer->text, text_layer->font, layer_get_bounds(layer),
+                         text_layer->overflow_mode, text_layer->alignment, NULL);
+    }
+    break;
+  }
+  case LayerKindBitmap:
+  {
+    BitmapLayer *bitmap_layer = layer->owner;
+    if (bitmap_layer->bitmap)
+    {
+      graphics_context_set_compositing_mode(&s_ctx, bitmap_layer->compositing_mode);
+      graphics_draw_bitmap_in_rect(&s_ctx, bitmap_layer->bitmap, layer_get_bounds(layer));
+    }
+    break;
+  }
+  case LayerKindPlain:
+    if (layer->update_proc)
+    {
+      PROBE_CALL(layer->update_proc, layer, &s_ctx);
+    }
+    break;
+  }
+  for (Layer *child = layer->first_child; child; child = child->next_sibling)
+  {
+    render_layer(child, layer_origin, layer_clip);
+  }
+}
+
+// The frame buffer belongs to the system, not the app heap.
+static uint8_t s_frame_buffer_data[PBL_DISPLAY_WIDTH * PBL_DISPLAY_HEIGHT];
+static GBitmap s_frame_buffer;
+
+const GBitmap *stub_frame_buffer(void)
+{
+  return &s_frame_buffer;
+}
+
+void stub_render(void)
+{
+  if (!s_render_pending || !s_top_window)
+  {
+    return;
+  }
+  s_render_pending = false;
+  stub_counters.frames++;
+  const uint64_t render_start = now_ns();
+  if (!s_frame_buffer.data)
+  {
+    s_frame_buffer.bounds = GRect(0, 0, PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT);
+    s_frame_buffer.format = native_format();
+    s_frame_buffer.row_size = row_size_for(s_frame_buffer.format, PBL_DISPLAY_WIDTH);
+    s_frame_buffer.data = s_frame_buffer_data;
+  }
+  memset(&s_ctx, 0, sizeof(s_ctx));
+  s_ctx.frame_buffer = &s_frame_buffer;
+  s_ctx.clip = s_frame_buffer.bounds;
+  if (raster_enabled())
+  {
+    raster_begin_frame();
+    raster_begin_owner("window");
+  }
+  // Like the firmware, a clear window background leaves the previous frame
+  // in place.
+  if (s_top_window->background_color.a)
+  {
+    graphics_context_set_fill_color(&s_ctx, s_top_window->background_color);
+    graphics_fill_rect(&s_ctx, layer_get_bounds(s_top_window->root), 0, GCornerNone);
+  }
+  render_layer(s_top_window->root, GPointZero, s_ctx.clip);
+  probe_record((const void *)stub_render, render_start);
+}
+
+// Persistent storage
+
+typedef struct
+{
+  bool used;
+  uint32_t key;
+  uint16_t size;
+  uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} PersistEntry;
+
+#define PERSIST_MAX_ENTRIES 128
+static PersistEntry s_persist[PERSIST_MAX_ENTRIES];
+
+void stub_persist_reset(void)
+{
+  memset(s_persist, 0, sizeof(s_persist));
+}
+
+static PersistEntry *persist_find(uint32_t key)
+{
+  for (int i = 0; i < PERSIST_MAX_ENTRIES; i++)
+  {
+    if (s_persist[i].used && s_persist[i].key == key)
+    {
+      return &s_persist[i];
+    }
+  }
+  return NULL;
+}
+
+static int persist_store(uint32_t key, const void *data, size_t size)
+{
+  if (size > PERSIST_DATA_MAX_LENGTH)
+  {
+    return E_INVALID_ARGUMENT;
+  }
+  PersistEntry *entry = persist_find(key);
+  for (int i = 0; !entry && i < PERSIST_MAX_ENTRIES; i++)
+  {
+    if (!s_persist[i].used)
+    {
+      entry = &s_persist[i];
+    }
+  }
+  if (!entry)
+  {
+    return E_ERROR;
+  }
+  entry->used = true;
+  entry->key = key;
+  entry->size = size;
+  memcpy(entry->data, data, size);
+  stub_counters.persist_bytes_written += size;
+  return size;
+}
+
+bool persist_exists(const uint32_t key)
+{
+  stub_counters.persist_reads++;
+  return persist_find(key) != NULL;
+}
+
+int persist_get_size(const uint32_t key)
+{
+  stub_counters.persist_reads++;
+  PersistEntry *entry = persist_find(key);
+  return entry ? entry->size : E_DOES_NOT_EXIST;
+}
+
+int32_t persist_read_int(const uint32_t key)
+{
+  stub_counters.persist_reads++;
+  PersistEntry *entry = persist_find(key);
+  int32_t value = 0;
+  if (entry)
+  {
+    memcpy(&value, entry->data, entry->size < sizeof(value) ? entry->size : sizeof(value));
+  }
+  return value;
+}
+
+bool persist_read_bool(const uint32_t key)
+{
+  return persist_read_int(key) != 0;
+}
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size)
+{
+  stub_counters.persist_reads++;
+  PersistEntry *entry = persist_find(key);
+  if (!entry)
+  {
+    return E_DOES_NOT_EXIST;
+  }
+  size_t size = entry->size < buffer_size ? entry->size : buffer_size;
+  memcpy(buffer, entry->data, size);
+  return size;
+}
+
+int persist_read_string(const uint32_t key, char *buffer, const size_t buffer_size)
+{
+  int size = persist_read_data(key, buffer, buffer_size);
+  if (size > 0)
+  {
+    buffer[size == (int)buffer_size ? size - 1 : size] = '\0';
+  }
+  return size;
+}
+
+status_t persist_write_int(const uint32_t key, const int32_t value)
+{
+  stub_counters.persist_write_int++;
+  return persist_store(key, &value, sizeof(value)) < 0 ? E_ERROR : S_SUCCESS;
+}
+
+status_t persist_write_bool(const uint32_t key, const bool value)
+{
+  return persist_write_int(key, value);
+}
+
+int persist_write_data(const uint32_t key, const void *data, const size_t size)
+{
+  stub_counters.persist_write_data++;
+  return persist_store(key, data, size);
+}
+
+int persist_write_string(const uint32_t key, const char *cstring)
+{
+  stub_counters.persist_write_string++;
+  return persist_store(key, cstring, strlen(cstring) + 1);
+}
+
+status_t persist_delete(const uint32_t key)
+{
+  PersistEntry *entry = persist_find(key);
+  if (!entry)
+  {
+    return E_DOES_NOT_EXIST;
+  }
+  entry->used = false;
+  return S_SUCCESS;
+}
+
+// Dictionaries
+
+#define TUPLE_HEADER_SIZE (sizeof(Tuple))
+
+DictionaryResult dict_write_begin(DictionaryIterator *iter, uint8_t *const buffer, const uint16_t size)
+{
+  if (!iter || !buffer || size < sizeof(Dictionary))
+  {
+    return DICT_INVALID_ARGS;
+  }
+  iter->dictionary = (Dictionary *)buffer;
+  iter->dictionary->count = 0;
+  iter->cursor = iter->dictionary->head;
+  iter->end = buffer + size;
+  return DICT_OK;
+}
+
+static DictionaryResult dict_write_tuple(DictionaryIterator *iter, uint32_t key, TupleType type, const void *data, uint16_t length)
+{
+  uint8_t *tuple_start = (uint8_t *)iter->cursor;
+  if (tuple_start + TUPLE_HEADER_SIZE + length > (const uint8_t *)iter->end)
+  {
+    return DICT_NOT_ENOUGH_STORAGE;
+  }
+  Tuple *tuple = iter->cursor;
+  tuple->key = key;
+  tuple->type = type;
+  tuple->length = length;
+  memcpy(tuple->value->data, data, length);
+  iter->cursor = (Tuple *)(tuple_start + TUPLE_HEADER_SIZE + length);
+  iter->dictionary->count++;
+  return DICT_OK;
+}
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t *const data, const uint16_t size)
+{
+  return dict_write_tuple(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, const uint32_t key, const char *const cstring)
+{
+  return dict_write_tuple(iter, key, TUPLE_CSTRING, cstring, strlen(cstring) + 1);
+}
+
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key, const void *integer, const uint8_t width_bytes, const bool is_signed)
+{
+  return dict_write_tuple(iter, key, is_signed ? TUPLE_INT : TUPLE_UINT, integer, width_bytes);
+}
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value)
+{
+  return dict_write_int(iter, key, &value, sizeof(value), false);
+}
+
+DictionaryResult dict_write_int8(DictionaryIterator *iter, const uint32_t key, const int8_t value)
+{
+  return dict_write_int(iter, key, &value, sizeof(value), true);
+}
+
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key, const int32_t value)
+{
+  return dict_write_int(iter, key, &value, sizeof(value), true);
+}
+
+uint32_t dict_write_end(DictionaryIterator *iter)
+{
+  iter->end = iter->cursor;
+  return (uint32_t)((uint8_t *)iter->cursor - (uint8_t *)iter->dictionary);
+}
+
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter, const uint8_t *const buffer, const uint16_t size)
+{
+  iter->dictionary = (Dictionary *)buffer;
+  iter->end = buffer + size;
+  return dict_read_first(iter);
+}
+
+Tuple *dict_read_first(DictionaryIterator *iter)
+{
+  iter->cursor = iter->dictionary->head;
+  if (iter->dictionary->count == 0 || (const uint8_t *)iter->cursor >= (const uint8_t *)iter->end)
+  {
+    return NULL;
+  }
+  return iter->cursor;
+}
+
+Tuple *dict_read_next(DictionaryIterator *iter)
+{
+  uint8_t *next = (uint8_t *)iter->cursor + TUPLE_HEADER_SIZE + iter->cursor->length;
+  if (next + TUPLE_HEADER_SIZE > (const uint8_t *)iter->end)
+  {
+    iter->cursor = (Tuple *)next;
+    return NULL;
+  }
+  iter->cursor = (Tuple *)next;
+  return iter->cursor;
+}
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key)
+{
+  DictionaryIterator scan = *iter;
+  for (Tuple *tuple = dict_read_first(&scan); tuple; tuple = dict_read_next(&scan))
+  {
+    if (tuple->key == key)
+    {
+      return tuple;
+    }
+  }
+  return NULL;
+}
+
+// AppMessage
+
+static AppMessageInboxReceived s_inbox_received;
+static AppMessageInboxDropped s_inbox_dropped;
+static AppMessageOutboxSent s_outbox_sent;
+static AppMessageOutboxFailed s_outbox_failed;
+static uint32_t s_inbox_size;
+static uint32_t s_outbox_size;
+static uint8_t s_outbox_buffer[1024];
+static DictionaryIterator s_outbox_iter;
+static uint16_t s_outbox_length;
+static bool s_outbox_open;
+static bool s_outbox_in_flight;
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound)
+{
+  s_inbox_size = size_inbound;
+  s_outbox_size = size_outbound < sizeof(s_outbox_buffer) ? size_outbound : sizeof(s_outbox_buffer);
+  // The firmware carves both buffers out of the app heap.
+  heap_charge(size_inbound + size_outbound);
+  return APP_MSG_OK;
+}
+
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback)
+{
+  AppMessageInboxReceived previous = s_inbox_received;
+  s_inbox_received = received_callback;
+  return previous;
+}
+
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback)
+{
+  AppMessageInboxDropped previous = s_inbox_dropped;
+  s_inbox_dropped = dropped_callback;
+  return previous;
+}
+
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback)
+{
+  AppMessageOutboxSent previous = s_outbox_sent;
+  s_outbox_sent = sent_callback;
+  return previous;
+}
+
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback)
+{
+  AppMessageOutboxFailed previous = s_outbox_failed;
+  s_outbox_failed = failed_callback;
+  return previous;
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator)
+{
+  if (s_outbox_in_flight || s_outbox_open)
+  {
+    stub_counters.outbox_busy++;
+    return APP_MSG_BUSY;
+  }
+  dict_write_begin(&s_outbox_iter, s_outbox_buffer, s_outbox_size);
+  s_outbox_open = true;
+  *iterator = &s_outbox_iter;
+  return APP_MSG_OK;
+}
+
+AppMessageResult app_message_outbox_send(void)
+{
+  if (!s_outbox_open)
+  {
+    return APP_MSG_INVALID_STATE;
+  }
+  s_outbox_open = false;
+  s_outbox_length = dict_write_end(&s_outbox_iter);
+  s_outbox_in_flight = true;
+  stub_counters.outbox_sends++;
+  return APP_MSG_OK;
+}
+
+uint16_t stub_phone_take_outbox(uint8_t *buffer, uint16_t size)
+{
+  if (!s_outbox_in_flight)
+  {
+    return 0;
+  }
+  uint16_t length = s_outbox_length < size ? s_outbox_length : size;
+  memcpy(buffer, s_outbox_buffer, length);
+  return length;
+}
+
+void stub_phone_ack_outbox(AppMessageResult result)
+{
+  if (!s_outbox_in_flight)
+  {
+    return;
+  }
+  s_outbox_in_flight = false;
+  DictionaryIterator iter;
+  dict_read_begin_from_buffer(&iter, s_outbox_buffer, s_outbox_length);
+  if (result == APP_MSG_OK)
+  {
+    if (s_outbox_sent)
+    {
+      PROBE_CALL(s_outbox_sent, &iter, NULL);
+    }
+  }
+  else if (s_outbox_failed)
+  {
+    PROBE_CALL(s_outbox_failed, &iter, result, NULL);
+  }
+  stub_render();
+}
+
+void stub_deliver_inbox(const uint8_t *buffer, uint16_t size)
+{
+  if (size > s_inbox_size)
+  {
+    stub_counters.inbox_dropped++;
+    if (s_inbox_dropped)
+    {
+      PROBE_CALL(s_inbox_dropped, APP_MSG_BUFFER_OVERFLOW, NULL);
+    }
+    stub_render();
+    return;
+  }
+  stub_counters.inbox_delivered++;
+  static uint8_t inbox[1024];
+  memcpy(inbox, buffer, size);
+  DictionaryIterator iter;
+  dict_read_begin_from_buffer(&iter, inbox, size);
+  if (s_inbox_received)
+  {
+    PROBE_CALL(s_inbox_received, &iter, NULL);
+  }
+  stub_render();
+}
+
+// Services
+
+static TickHandler s_tick_handler;
+static AccelTapHandler s_tap_handler;
+static BatteryStateHandler s_battery_handler;
+static BatteryChargeState s_battery_state = {.charge_percent = 100};
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler)
+{
+  s_tick_handler = handler;
+}
+
+void tick_timer_service_unsubscribe(void)
+{
+  s_tick_handler = NULL;
+}
+
+void stub_fire_tick(TimeUnits units_changed)
+{
+  if (s_tick_handler)
+  {
+    struct tm tick_time = *localtime(&s_now);
+    PROBE_CALL(s_tick_handler, &tick_time, units_changed);
+  }
+  stub_render();
+}
+
+void accel_tap_service_subscribe(AccelTapHandler handler)
+{
+  s_tap_handler = handler;
+}
+
+void accel_tap_service_unsubscribe(void)
+{
+  s_tap_handler = NULL;
+}
+
+bool stub_tap_subscribed(void)
+{
+  return s_tap_handler != NULL;
+}
+
+void stub_fire_tap(AccelAxisType axis, int32_t direction)
+{
+  if (s_tap_handler)
+  {
+    PROBE_CALL(s_tap_handler, axis, direction);
+  }
+  stub_render();
+}
+
+void battery_state_service_subscribe(BatteryStateHandler handler)
+{
+  s_battery_handler = handler;
+}
+
+void battery_state_service_unsubscribe(void)
+{
+  s_battery_handler = NULL;
+}
+
+BatteryChargeState battery_state_service_peek(void)
+{
+  return s_battery_state;
+}
+
+void stub_set_battery(BatteryChargeState state)
+{
+  s_battery_state = state;
+}
+
+void stub_fire_battery(BatteryChargeState state)
+{
+  s_battery_state = state;
+  if (s_battery_handler)
+  {
+    PROBE_CALL(s_battery_handler, state);
+  }
+  stub_render();
+}
+
+// Minute records for the last two days, indexed by minute since the epoch,
+// so sums cost what they would on the watch: one record per minute covered.
+#define HEALTH_RECORD_MINUTES (2 * 24 * 60)
+static HealthValue s_health_records[HealthMetricHeartRateBPM + 1][HEALTH_RECORD_MINUTES];
+static HealthEventHandler s_health_handler;
+static void *s_health_context;
+
+void stub_add_health(HealthMetric metric, HealthValue value)
+{
+  s_health_records[metric][(s_now / 60) % HEALTH_RECORD_MINUTES] += value;
+}
+
+void stub_fire_health_event(HealthEventType event)
+{
+  if (s_health_handler)
+  {
+    PROBE_CALL(s_health_handler, event, s_health_context);
+  }
+  stub_render();
+}
+
+time_t time_start_of_today(void)
+{
+  return s_now - s_now % (24 * 60 * 60);
+}
+
+HealthValue health_service_sum(HealthMetric metric, time_t time_start, time_t time_end)
+{
+  stub_counters.health_queries++;
+  HealthValue sum = 0;
+  for (time_t minute = time_start / 60; minute * 60 < time_end; minute++)
+  {
+    stub_counters.health_records_scanned++;
+    sum += s_health_records[metric][minute % HEALTH_RECORD_MINUTES];
+  }
+  return sum;
+}
+
+// Like the firmware, the range is widened to whole minutes and cut to what
+// fits in minute_data; both ends are updated to what was returned.
+uint32_t health_service_get_minute_history(HealthMinuteData *minute_data, uint32_t max_records, time_t *time_start, time_t *time_end)
+{
+  stub_counters.health_queries++;
+  const time_t first = *time_start / 60;
+  uint32_t count = 0;
+  for (time_t minute = first; minute * 60 < *time_end && count < max_records; minute++, count++)
+  {
+    stub_counters.health_records_scanned++;
+    stub_counters.health_minute_records++;
+    const HealthValue steps = s_health_records[HealthMetricStepCount][minute % HEALTH_RECORD_MINUTES];
+    minute_data[count] = (HealthMinuteData){.steps = steps > UINT8_MAX ? UINT8_MAX : steps};
+  }
+  *time_start = first * 60;
+  *time_end = (first + count) * 60;
+  return count;
+}
+
+HealthValue health_service_sum_today(HealthMetric metric)
+{
+  return health_service_sum(metric, time_start_of_today(), s_now + 1);
+}
+
+bool health_service_events_subscribe(HealthEventHandler handler, void *context)
+{
+#if defined(PBL_HEALTH)
+  s_health_handler = handler;
+  s_health_context = context;
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool health_service_events_unsubscribe(void)
+{
+  s_health_handler = NULL;
+  return true;
+}
+
+static ConnectionHandlers s_connection_handlers;
+static bool s_connected = true;
+
+void connection_service_subscribe(ConnectionHandlers conn_handlers)
+{
+  s_connection_handlers = conn_handlers;
+}
+
+void connection_service_unsubscribe(void)
+{
+  memset(&s_connection_handlers, 0, sizeof(s_connection_handlers));
+}
+
+bool connection_service_peek_pebble_app_connection(void)
+{
+  return s_connected;
+}
+
+bool connection_service_peek_pebblekit_connection(void)
+{
+  return s_connected;
+}
+
+void stub_set_connected(bool connected)
+{
+  if (connected == s_connected)
+  {
+    return;
+  }
+  s_connected = connected;
+  if (s_connection_handlers.pebble_app_connection_handler)
+  {
+    PROBE_CALL(s_connection_handlers.pebble_app_connection_handler, connected);
+  }
+  stub_render();
+}
+
+static UnobstructedAreaHandlers s_unobstructed_handlers;
+static void *s_unobstructed_context;
+
+void unobstructed_area_service_subscribe(UnobstructedAreaHandlers handlers, void *context)
+{
+  s_unobstructed_handlers = handlers;
+  s_unobstructed_context = context;
+}
+
+void unobstructed_area_service_unsubscribe(void)
+{
+  memset(&s_unobstructed_handlers, 0, sizeof(s_unobstructed_handlers));
+}
+
+void stub_animate_obstruction(int16_t height, int steps)
+{
+  const int16_t from = s_obstruction;
+  if (s_unobstructed_handlers.will_change)
+  {
+    PROBE_CALL(s_unobstructed_handlers.will_change, GRect(0, 0, PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT - height), s_unobstructed_context);
+  }
+  stub_render();
+  for (int step = 1; step <= steps; step++)
+  {
+    s_obstruction = from + (height - from) * step / steps;
+    if (s_unobstructed_handlers.change)
+    {
+      PROBE_CALL(s_unobstructed_handlers.change, (AnimationProgress)((int64_t)ANIMATION_NORMALIZED_MAX * step / steps), s_unobstructed_context);
+    }
+    stub_render();
+  }
+  if (s_unobstructed_handlers.did_change)
+  {
+    PROBE_CALL(s_unobstructed_handlers.did_change, s_unobstructed_context);
+  }
+  stub_render();
+}
+
+// Timers
+
+struct AppTimer
+{
+  bool active;
+  uint64_t due_ms;
+  uint32_t order;
+  AppTimerCallback callback;
+  void *data;
+};
+
+#define STUB_MAX_TIMERS 8
+static AppTimer s_timers[STUB_MAX_TIMERS];
+static uint32_t s_timer_order;
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data)
+{
+  for (int i = 0; i < STUB_MAX_TIMERS; i++)
+  {
+    if (!s_timers[i].active)
+    {
+      s_timers[i] = (AppTimer){
+          .active = true,
+          .due_ms = clock_ms() + timeout_ms,
+          .order = s_timer_order++,
+          .callback = callback,
+          .data = callback_data,
+      };
+      return &s_timers[i];
+    }
+  }
+  return NULL;
+}
+
+void app_timer_cancel(AppTimer *timer_handle)
+{
+  if (timer_handle)
+  {
+    timer_handle->active = false;
+  }
+}
+
+// Timer callbacks are timed together under the app_timer_register probe.
+static void fire_timers(uint64_t until_ms)
+{
+  for (;;)
+  {
+    AppTimer *next = NULL;
+    for (int i = 0; i < STUB_MAX_TIMERS; i++)
+    {
+      AppTimer *timer = &s_timers[i];
+      if (timer->active && timer->due_ms <= until_ms &&
+          (!next || timer->due_ms < next->due_ms || (timer->due_ms == next->due_ms && timer->order < next->order)))
+      {
+        next = timer;
+      }
+    }
+    if (!next)
+    {
+      return;
+    }
+    if (next->due_ms > clock_ms())
+    {
+      set_clock_ms(next->due_ms);
+    }
+    next->active = false;
+    const uint64_t start = now_ns();
+    next->callback(next->data);
+    probe_record((const void *)app_timer_register, start);
+    stub_render();
+  }
+}
+
+// App lifecycle
+
+static void (*s_event_loop)(void);
+
+void stub_set_event_loop(void (*loop)(void))
+{
+  s_event_loop = loop;
+}
+
+void app_event_loop(void)
+{
+  stub_render();
+  if (s_event_loop)
+  {
+    s_event_loop();
+  }
+}
@@ -0,0 +1,103 @@
+// Driver-facing side of the host SDK stub: counters, the simulated clock and
+// phone link, and hooks for firing the services the watchface subscribes to.
+#pragma once
+
+#include "pebble.h"
+
+#define STUB_COUNTERS(X)          \
+  X(frames)                       \
+  X(layer_mark_dirty)             \
+  X(text_layer_mutations)         \
+  X(graphics_fill_radial)         \
+  X(graphics_fill_circle)         \
+  X(graphics_fill_rect)           \
+  X(gpath_draw_filled)            \
+  X(graphics_draw_bitmap)         \
+  X(graphics_draw_text)           \
+  X(persist_reads)                \
+  X(persist_write_int)            \
+  X(persist_write_string)         \
+  X(persist_write_data)           \
+  X(persist_bytes_written)        \
+  X(resource_loads)               \
+  X(health_queries)               \
+  X(health_records_scanned)       \
+  X(health_minute_records)        \
+  X(outbox_sends)                 \
+  X(outbox_busy)                  \
+  X(inbox_delivered)              \
+  X(inbox_dropped)
+
+typedef struct
+{
+#define STUB_COUNTER_FIELD(name) uint32_t name;
+  STUB_COUNTERS(STUB_COUNTER_FIELD)
+#undef STUB_COUNTER_FIELD
+} StubCounters;
+
+extern StubCounters stub_counters;
+
+// Wall-time accounting for one handler or update proc.
+typedef struct
+{
+  const char *name;
+  const void *fn;
+  uint32_t calls;
+  uint64_t total_ns;
+  uint64_t max_ns;
+} StubProbe;
+
+#define STUB_MAX_PROBES 32
+
+void stub_probe_name(const void *fn, const char *name);
+const StubProbe *stub_probes(int *count);
+
+// High-water mark of heap_bytes_used() since the last reset.
+size_t stub_heap_peak(void);
+void stub_heap_reset_peak(void);
+
+// Simulated clock, in local time (the driver runs with TZ=UTC). App timers
+// due before the new time fire first, in order, each at its due time and
+// followed by a render pass.
+void stub_set_time(time_t now);
+void stub_advance_ms(uint32_t ms);
+time_t stub_now(void);
+
+// Scripted sensors.
+void stub_add_health(HealthMetric metric, HealthValue value);
+void stub_fire_health_event(HealthEventType event);
+void stub_set_battery(BatteryChargeState state);
+void stub_set_24h_style(bool is_24h);
+
+// Firing subscribed services. Each call is timed and followed by a render
+// pass if anything was marked dirty, like one turn of the app event loop.
+void stub_fire_tick(TimeUnits units_changed);
+void stub_fire_battery(BatteryChargeState state);
+void stub_fire_tap(AccelAxisType axis, int32_t direction);
+void stub_deliver_inbox(const uint8_t *buffer, uint16_t size);
+// Whether the app currently takes accelerometer tap events.
+bool stub_tap_subscribed(void);
+
+// Phone side of the AppMessage link. Returns the size of the dictionary the
+// watch has in flight, or 0 if there is none, and copies it to buffer.
+uint16_t stub_phone_take_outbox(uint8_t *buffer, uint16_t size);
+void stub_phone_ack_outbox(AppMessageResult result);
+void stub_set_connected(bool connected);
+
+// Slides the Timeline Quick View obstruction to height pixels over steps
+// animation frames, firing the unobstructed area handlers and rendering
+// each frame.
+void stub_animate_obstruction(int16_t height, int steps);
+
+// Emulates the compositor: if any layer is dirty, the whole window is redrawn.
+void stub_render(void);
+
+// What the last stub_render() left on screen. Only drawn into once
+// raster_enable() has been called.
+const GBitmap *stub_frame_buffer(void);
+
+// Persistent storage seeding for cold-start scenarios.
+void stub_persist_reset(void);
+
+// Runs once inside app_event_loop().
+void stub_set_event_loop(void (*loop)(void));
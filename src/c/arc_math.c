@@ -0,0 +1,50 @@
+#include "arc_math.h"
+
+// The temperature gauge sweeps clockwise from 235 to 485 degrees, leaving a
+// gap at the bottom for the low/high labels.
+#define TEMPERATURE_SWEEP_START DEG_TO_TRIGANGLE(235)
+#define TEMPERATURE_SWEEP DEG_TO_TRIGANGLE(485 - 235)
+#define TEMPERATURE_MARKER_RADIUS (ARC_WIDTH / 2 - 2)
+
+const GRect ARC_RINGS[3] = {
+    {{0, 0}, {ARC_WIDTH, ARC_WIDTH}},
+    {{ARC_RING_SPACING, ARC_RING_SPACING}, {ARC_WIDTH - 2 * ARC_RING_SPACING, ARC_WIDTH - 2 * ARC_RING_SPACING}},
+    {{2 * ARC_RING_SPACING, 2 * ARC_RING_SPACING}, {ARC_WIDTH - 4 * ARC_RING_SPACING, ARC_WIDTH - 4 * ARC_RING_SPACING}},
+};
+
+int32_t arc_steps(int32_t value, int32_t goal)
+{
+  if (value <= 0)
+  {
+    return 0;
+  }
+  if (goal <= 0 || value >= goal)
+  {
+    return ARC_STEPS;
+  }
+  // Keep value << ARC_STEPS_SHIFT inside 32 bits for very large goals.
+  while (goal > (INT32_MAX >> ARC_STEPS_SHIFT))
+  {
+    value >>= 1;
+    goal >>= 1;
+  }
+  return (value << ARC_STEPS_SHIFT) / goal;
+}
+
+GPoint arc_temperature_marker(int32_t temperature, int32_t low, int32_t high)
+{
+  int32_t angle = TEMPERATURE_SWEEP_START;
+  if (high > low)
+  {
+    if (temperature > high)
+    {
+      temperature = high;
+    }
+    if (temperature > low)
+    {
+      angle += TEMPERATURE_SWEEP * (temperature - low) / (high - low);
+    }
+  }
+  return GPoint(ARC_WIDTH / 2 + TEMPERATURE_MARKER_RADIUS * sin_lookup(angle) / TRIG_MAX_RATIO,
+                ARC_WIDTH / 2 - TEMPERATURE_MARKER_RADIUS * cos_lookup(angle) / TRIG_MAX_RATIO);
+}
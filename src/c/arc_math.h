@@ -0,0 +1,37 @@
+#pragma once
+
+#include <pebble.h>
+
+// Integer geometry for the ring widgets. Everything here is TRIG_MAX_ANGLE
+// arithmetic so the update procs never touch the soft-float library.
+
+#if defined(PBL_PLATFORM_EMERY)
+#define ARC_WIDTH 60
+#define ARC_STEPS_SHIFT 8
+#else
+#define ARC_WIDTH 41
+#define ARC_STEPS_SHIFT 7
+#endif
+
+// Progress arcs are quantised to ARC_STEPS positions, roughly one pixel of
+// the outer ring's circumference each, so converting to an angle is a shift.
+#define ARC_STEPS (1 << ARC_STEPS_SHIFT)
+#define ARC_STEP_ANGLE (TRIG_MAX_ANGLE >> ARC_STEPS_SHIFT)
+
+#define ARC_RING_THICKNESS 5
+#define ARC_RING_SPACING 7
+
+// Bounds of the outer, middle and inner rings within a widget.
+extern const GRect ARC_RINGS[3];
+
+// Number of steps of a full ring covered by value out of goal, clamped to
+// [0, ARC_STEPS].
+int32_t arc_steps(int32_t value, int32_t goal);
+
+static inline int32_t arc_steps_to_angle(int32_t steps)
+{
+  return steps * ARC_STEP_ANGLE;
+}
+
+// Centre of the temperature marker for temperature on the low..high gauge.
+GPoint arc_temperature_marker(int32_t temperature, int32_t low, int32_t high);
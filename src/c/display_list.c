@@ -0,0 +1,155 @@
+#include "display_list.h"
+
+#if defined(MODULUS_DISPLAY_LIST)
+
+static Layer *s_canvas;
+static DisplayItem *s_items;
+static size_t s_item_count;
+static GColor s_background;
+static bool s_full_redraw;
+
+static bool frames_overlap(GRect a, GRect b)
+{
+  return a.origin.x < b.origin.x + b.size.w && b.origin.x < a.origin.x + a.size.w &&
+         a.origin.y < b.origin.y + b.size.h && b.origin.y < a.origin.y + a.size.h;
+}
+
+// Repainting an item clears its frame first, so every item overlapping a
+// dirty one has to be repainted too, transitively.
+static void spread_dirty()
+{
+  bool spread = true;
+  while (spread)
+  {
+    spread = false;
+    for (size_t i = 0; i < s_item_count; i++)
+    {
+      if (s_items[i].dirty)
+      {
+        continue;
+      }
+      for (size_t j = 0; j < s_item_count; j++)
+      {
+        if (s_items[j].dirty && frames_overlap(s_items[i].frame, s_items[j].frame))
+        {
+          s_items[i].dirty = true;
+          spread = true;
+          break;
+        }
+      }
+    }
+  }
+}
+
+static void draw_item(GContext *ctx, const DisplayItem *item)
+{
+  if (item->hidden)
+  {
+    return;
+  }
+  switch (item->kind)
+  {
+  case DisplayItemText:
+    if (item->text && item->text[0])
+    {
+      graphics_context_set_text_color(ctx, item->color);
+      graphics_draw_text(ctx, item->text, item->font, item->frame, item->overflow, item->alignment, NULL);
+    }
+    break;
+  case DisplayItemBitmap:
+    if (item->bitmap)
+    {
+      graphics_context_set_compositing_mode(ctx, GCompOpSet);
+      graphics_draw_bitmap_in_rect(ctx, item->bitmap, item->frame);
+    }
+    break;
+  case DisplayItemCustom:
+    item->draw(ctx, item->frame);
+    break;
+  }
+}
+
+void display_list_update_proc(Layer *layer, GContext *ctx)
+{
+  graphics_context_set_fill_color(ctx, s_background);
+  if (s_full_redraw)
+  {
+    s_full_redraw = false;
+    graphics_fill_rect(ctx, layer_get_bounds(layer), 0, GCornerNone);
+    for (size_t i = 0; i < s_item_count; i++)
+    {
+      s_items[i].dirty = true;
+    }
+  }
+  else
+  {
+    spread_dirty();
+    for (size_t i = 0; i < s_item_count; i++)
+    {
+      if (s_items[i].dirty)
+      {
+        graphics_fill_rect(ctx, s_items[i].frame, 0, GCornerNone);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < s_item_count; i++)
+  {
+    if (s_items[i].dirty)
+    {
+      s_items[i].dirty = false;
+      draw_item(ctx, &s_items[i]);
+    }
+  }
+}
+
+Layer *display_list_create(GRect frame, DisplayItem *items, size_t count)
+{
+  s_items = items;
+  s_item_count = count;
+  s_full_redraw = true;
+  s_canvas = layer_create(frame);
+  layer_set_update_proc(s_canvas, display_list_update_proc);
+  return s_canvas;
+}
+
+void display_list_destroy(void)
+{
+  layer_destroy(s_canvas);
+  s_canvas = NULL;
+  s_items = NULL;
+  s_item_count = 0;
+}
+
+void display_list_set_background(GColor color)
+{
+  s_background = color;
+  display_list_invalidate();
+}
+
+void display_list_mark_dirty(DisplayItem *item)
+{
+  item->dirty = true;
+  layer_mark_dirty(s_canvas);
+}
+
+// A hidden item still has its frame cleared, so hiding it erases it.
+void display_list_set_hidden(DisplayItem *item, bool hidden)
+{
+  if (item->hidden != hidden)
+  {
+    item->hidden = hidden;
+    display_list_mark_dirty(item);
+  }
+}
+
+void display_list_invalidate(void)
+{
+  s_full_redraw = true;
+  if (s_canvas)
+  {
+    layer_mark_dirty(s_canvas);
+  }
+}
+
+#endif
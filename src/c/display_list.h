@@ -0,0 +1,45 @@
+#pragma once
+
+#include <pebble.h>
+
+// Alternative to a layer per widget, enabled with MODULUS_DISPLAY_LIST: one
+// canvas layer draws a caller-owned array of items in order. A frame only
+// repaints the items marked dirty, plus whatever overlaps them, on top of
+// what the previous frame left in the frame buffer. For that the window
+// background has to be GColorClear; the canvas paints the real background
+// itself. Call display_list_invalidate() whenever something else may have
+// drawn over the window.
+
+typedef enum
+{
+  DisplayItemText,
+  DisplayItemBitmap,
+  DisplayItemCustom,
+} DisplayItemKind;
+
+typedef void (*DisplayItemDrawProc)(GContext *ctx, GRect frame);
+
+typedef struct
+{
+  DisplayItemKind kind;
+  bool dirty;
+  bool hidden;
+  GRect frame;
+  GColor color;
+  GTextAlignment alignment;
+  GTextOverflowMode overflow;
+  GFont font;
+  const char *text;
+  const GBitmap *bitmap;
+  DisplayItemDrawProc draw;
+} DisplayItem;
+
+Layer *display_list_create(GRect frame, DisplayItem *items, size_t count);
+void display_list_destroy(void);
+void display_list_set_background(GColor color);
+void display_list_mark_dirty(DisplayItem *item);
+void display_list_set_hidden(DisplayItem *item, bool hidden);
+void display_list_invalidate(void);
+
+// The canvas update proc, public so profilers can name it.
+void display_list_update_proc(Layer *layer, GContext *ctx);
@@ -0,0 +1,77 @@
+#include "forecast.h"
+
+#define SECONDS_PER_HOUR 3600
+
+// A ring of hourly entries: head is the hour starting at start, and passed
+// hours are popped off the front as time moves on.
+typedef struct __attribute__((__packed__))
+{
+  uint8_t version;
+  uint32_t start;
+  uint8_t head;
+  uint8_t count;
+  ForecastHour hours[FORECAST_HOURS];
+} Forecast;
+
+static Forecast s_forecast;
+
+bool forecast_store(const uint8_t *data, size_t length)
+{
+  if (length < FORECAST_PAYLOAD_HEADER_SIZE || data[0] != FORECAST_PAYLOAD_VERSION)
+  {
+    return false;
+  }
+  const uint8_t count = data[5];
+  if (count > FORECAST_HOURS || FORECAST_PAYLOAD_HEADER_SIZE + count * 2u > length)
+  {
+    return false;
+  }
+  s_forecast.version = FORECAST_PAYLOAD_VERSION;
+  s_forecast.start = data[1] | data[2] << 8 | data[3] << 16 | (uint32_t)data[4] << 24;
+  s_forecast.head = 0;
+  s_forecast.count = count;
+  const uint8_t *entry = &data[FORECAST_PAYLOAD_HEADER_SIZE];
+  for (uint8_t i = 0; i < count; i++, entry += 2)
+  {
+    s_forecast.hours[i] = (ForecastHour){
+        .temperature = (int8_t)entry[0],
+        .conditions = entry[1] & 0x0F,
+    };
+  }
+  return true;
+}
+
+const ForecastHour *forecast_current(time_t now)
+{
+  while (s_forecast.count && now >= (time_t)s_forecast.start + SECONDS_PER_HOUR)
+  {
+    s_forecast.head = (s_forecast.head + 1) % FORECAST_HOURS;
+    s_forecast.start += SECONDS_PER_HOUR;
+    s_forecast.count--;
+  }
+  if (!s_forecast.count || now < (time_t)s_forecast.start)
+  {
+    return NULL;
+  }
+  return &s_forecast.hours[s_forecast.head];
+}
+
+bool forecast_covers(time_t until)
+{
+  return s_forecast.count && until < (time_t)s_forecast.start + s_forecast.count * SECONDS_PER_HOUR;
+}
+
+void forecast_load(uint32_t persist_key)
+{
+  if (persist_read_data(persist_key, &s_forecast, sizeof(s_forecast)) != (int)sizeof(s_forecast) ||
+      s_forecast.version != FORECAST_PAYLOAD_VERSION || s_forecast.count > FORECAST_HOURS ||
+      s_forecast.head >= FORECAST_HOURS)
+  {
+    memset(&s_forecast, 0, sizeof(s_forecast));
+  }
+}
+
+void forecast_save(uint32_t persist_key)
+{
+  persist_write_data(persist_key, &s_forecast, sizeof(s_forecast));
+}
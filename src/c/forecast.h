@@ -0,0 +1,35 @@
+#pragma once
+
+#include <pebble.h>
+
+// Hourly forecast kept on the watch so the face can stay current for hours
+// between fetches. The phone sends it under MESSAGE_KEY_FORECAST, packed by
+// packForecast() in src/pkjs/index.js:
+//   [0]     format version, FORECAST_PAYLOAD_VERSION
+//   [1..4]  start of the first hour, unix time, little-endian
+//   [5]     number of hours N, then N entries of two bytes:
+//           temperature as int8, condition index in the low nibble
+//           (0x0F when unknown, as in the weather payload)
+
+#define FORECAST_PAYLOAD_VERSION 1
+#define FORECAST_PAYLOAD_HEADER_SIZE 6
+#define FORECAST_HOURS 24
+
+typedef struct
+{
+  int8_t temperature;
+  uint8_t conditions;
+} ForecastHour;
+
+// Replaces the stored hours with a payload. Returns false if it is malformed.
+bool forecast_store(const uint8_t *data, size_t length);
+
+// Drops the hours that have passed and returns the one covering now, or
+// NULL if the forecast does not reach that far.
+const ForecastHour *forecast_current(time_t now);
+
+// Whether the stored hours reach at least until the given time.
+bool forecast_covers(time_t until);
+
+void forecast_load(uint32_t persist_key);
+void forecast_save(uint32_t persist_key);
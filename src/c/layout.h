@@ -0,0 +1,69 @@
+#pragma once
+
+#include <pebble.h>
+
+// Per-platform geometry, chosen at compile time so each binary only carries
+// its own numbers. A new screen size is one more LAYOUT and LAYOUT_BOLT
+// block here; the frames themselves are derived in layout_compute(). The
+// bolt path is separate because gpath_create() needs its address, while
+// LAYOUT is only read field by field and folds into the code.
+
+typedef struct
+{
+  uint32_t time_font;
+  const char *label_font;
+  const char *range_font;
+  int16_t time_top;
+  int16_t time_height;
+  int16_t label_top;
+  int16_t label_height;
+  // Tops of the location line and the condition icon, above the widgets.
+  int16_t location_rise;
+  int16_t condition_rise;
+  // Top of the temperature text, above the middle of its ring.
+  int16_t temperature_rise;
+  // Top of the low and high labels, above the bottom of the ring.
+  int16_t range_rise;
+  GSize range_size;
+  GPoint bolt_origin;
+} LayoutMetrics;
+
+#if defined(PBL_PLATFORM_EMERY)
+static const LayoutMetrics LAYOUT = {
+    .time_font = RESOURCE_ID_FONT_TOMORROW_62,
+    .label_font = FONT_KEY_GOTHIC_24_BOLD,
+    .range_font = FONT_KEY_GOTHIC_14_BOLD,
+    .time_top = 20,
+    .time_height = 62,
+    .label_top = -2,
+    .label_height = 28,
+    .location_rise = 36,
+    .condition_rise = 30,
+    .temperature_rise = 17,
+    .range_rise = 12,
+    .range_size = {24, 18},
+    .bolt_origin = {14, 12},
+};
+static const GPathInfo LAYOUT_BOLT = {
+    .num_points = 6,
+    .points = (GPoint[]){{18, 0}, {17, 15}, {24, 15}, {12, 36}, {13, 21}, {6, 21}}};
+#else
+static const LayoutMetrics LAYOUT = {
+    .time_font = RESOURCE_ID_FONT_TOMORROW_45,
+    .label_font = FONT_KEY_GOTHIC_18_BOLD,
+    .range_font = FONT_KEY_GOTHIC_09,
+    .time_top = 20,
+    .time_height = 52,
+    .label_top = 0,
+    .label_height = 21,
+    .location_rise = 30,
+    .condition_rise = 30,
+    .temperature_rise = 13,
+    .range_rise = 9,
+    .range_size = {20, 15},
+    .bolt_origin = {10, 8},
+};
+static const GPathInfo LAYOUT_BOLT = {
+    .num_points = 6,
+    .points = (GPoint[]){{12, 0}, {11, 10}, {16, 10}, {8, 24}, {9, 14}, {4, 14}}};
+#endif
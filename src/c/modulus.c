@@ -1,30 +1,60 @@
 #include <pebble.h>
+#include "arc_math.h"
+#include "display_list.h"
+#include "forecast.h"
+#include "layout.h"
+#include "outbox.h"
+#include "perf.h"
+#include "places.h"
+#include "step_history.h"
+
+// Everything on the face, in drawing order. By default each view is its own
+// layer; built with MODULUS_DISPLAY_LIST they are items of one display list
+// canvas instead.
+typedef enum
+{
+  VIEW_TIME,
+  VIEW_DAY,
+  VIEW_DATE,
+  VIEW_CONDITION,
+  VIEW_LOCATION,
+  VIEW_TEMPERATURE_ARC,
+  VIEW_TEMPERATURE,
+  VIEW_LOW,
+  VIEW_HIGH,
+  VIEW_HEALTH,
+  VIEW_STEP_HISTORY,
+  VIEW_BATTERY,
+  VIEW_COUNT,
+} ViewId;
 
 static Window *s_window;
-static TextLayer *s_time_layer;
-static TextLayer *s_day_layer;
-static TextLayer *s_date_layer;
-static TextLayer *s_loc_layer;
-static TextLayer *s_temperature_layer;
-static TextLayer *s_high_layer;
-static TextLayer *s_low_layer;
-static Layer *s_temp_arc_layer;
-static Layer *s_health_layer;
-static Layer *s_battery_layer;
-static BitmapLayer *s_condition_layer;
-static GBitmap *s_condition_bitmap;
-static GFont tomorrow_62;
-static GFont tomorrow_45;
-
+#if defined(MODULUS_DISPLAY_LIST)
+static DisplayItem s_views[VIEW_COUNT];
+#else
+static struct
+{
+  DisplayItemKind kind;
+  union
+  {
+    TextLayer *text;
+    BitmapLayer *bitmap;
+    Layer *custom;
+  };
+} s_views[VIEW_COUNT];
+#endif
+static GRect s_view_frames[VIEW_COUNT];
+static GBitmap *s_weather_atlas;
+static GBitmap *s_temperature_ring_cache = NULL;
+static GBitmap *s_health_ring_cache = NULL;
+static GFont s_time_font;
+
+// The time font and bolt come from LAYOUT, so each platform only builds in
+// and loads its own. package.json limits the font resources to match.
 static GPath *s_bolt_path = NULL;
-static const GPathInfo BOLT_PATH_INFO = {
-    .num_points = 6,
-    .points = (GPoint[]){{12, 0}, {11, 10}, {16, 10}, {8, 24}, {9, 14}, {4, 14}}};
-static const GPathInfo BOLT_LARGE_PATH_INFO = {
-    .num_points = 6,
-    .points = (GPoint[]){{18, 0}, {17, 15}, {24, 15}, {12, 36}, {13, 21}, {6, 21}}};
 
 static GPath *s_check_path = NULL;
+#define CHECK_ORIGIN GPoint((ARC_WIDTH - 18) / 2, (ARC_WIDTH - 15) / 2)
 static const GPathInfo CHECK_PATH_INFO = {
     .num_points = 10,
     .points = (GPoint[]){
@@ -39,535 +69,1592 @@ static const GPathInfo CHECK_PATH_INFO = {
         {5, 15},
         {0, 10}}};
 
-static GColor background_color;
+// Everything that survives a restart lives in one blob under SETTINGS_KEY, so
+// startup is a single persist read and a config message a single write.
+#define SETTINGS_KEY 1
+#define SETTINGS_VERSION 3
+// The hourly forecast is written separately, only when a new one arrives.
+#define FORECAST_KEY 2
+// The step history is written once an hour and on exit.
+#define STEP_HISTORY_KEY 3
+// Saved places are written when the phone sends a new table.
+#define PLACES_KEY 4
+
+typedef struct __attribute__((__packed__))
+{
+  uint8_t version;
+  GColor background_color;
+  GColor accent_color;
+  GColor health_outer_arc_color;
+  GColor health_middle_arc_color;
+  GColor health_inner_arc_color;
+  int32_t step_goal;
+  int32_t move_goal;
+  int32_t active_goal;
+  int32_t weather_update_interval;
+  int32_t weather_index;
+  int32_t temperature;
+  int32_t low_temp;
+  int32_t high_temp;
+  char location[64];
+  // Added in version 2.
+  uint8_t low_power_level;
+  uint8_t quiet_start;
+  uint8_t quiet_end;
+  // Added in version 3: when the last weather reply arrived, so a restart
+  // does not refetch data that is still fresh.
+  uint32_t weather_updated;
+} Settings;
+
+// Older blobs end where the next version's fields start.
+#define SETTINGS_V1_SIZE offsetof(Settings, low_power_level)
+#define SETTINGS_V2_SIZE offsetof(Settings, weather_updated)
+
+static Settings s_settings;
+static Settings s_stored_settings;
+
 static GColor text_color;
-static GColor accent_color;
-static GColor health_outer_arc_color;
-static GColor health_middle_arc_color;
-static GColor health_inner_arc_color;
 
 static int32_t step_count = 0;
-static int32_t step_goal = 5000;
 static int32_t move_minutes = 0;
-static int32_t move_goal = 30;
 static int32_t active_calories = 0;
-static int32_t active_goal = 300;
 static int32_t battery_level = 100;
-static int32_t temperature = 20;
-static int32_t low_temp = 15;
-static int32_t high_temp = 25;
 static char temp_buffer[8];
 static char low_buffer[8];
 static char high_buffer[8];
-static char location[64] = "My Location";
-static int32_t weather_update_interval = 30;
-static int weather_index = 0;
+
+// Last values pushed to the screen, so a tick only touches the layers whose
+// inputs actually changed.
+static struct
+{
+  int day_stamp;
+  bool temperatures_shown;
+  int32_t temperature;
+  int32_t low_temp;
+  int32_t high_temp;
+  int32_t weather_index;
+  int32_t step_arc;
+  int32_t move_arc;
+  int32_t active_arc;
+  bool goals_met;
+} s_rendered = {.day_stamp = -1, .step_arc = -1, .move_arc = -1, .active_arc = -1};
 
 static const int PADDING = 4;
-static const int32_t WEATHER_ICONS[6] = {
-    RESOURCE_ID_CLEAR,
-    RESOURCE_ID_CLOUD,
-    RESOURCE_ID_FOG,
-    RESOURCE_ID_RAIN,
-    RESOURCE_ID_SNOW,
-    RESOURCE_ID_STORM,
-};
-static int16_t arc_width = PBL_PLATFORM_TYPE_CURRENT == PlatformTypeEmery ? 60 : 41;
 
-static void request_weather()
+#if !defined(MODULUS_DISPLAY_LIST)
+static Layer *view_layer(ViewId view)
 {
-  DictionaryIterator *iter;
-  app_message_outbox_begin(&iter);
-  dict_write_uint8(iter, 0, 0);
-  app_message_outbox_send();
+  switch (s_views[view].kind)
+  {
+  case DisplayItemText:
+    return text_layer_get_layer(s_views[view].text);
+  case DisplayItemBitmap:
+    return bitmap_layer_get_layer(s_views[view].bitmap);
+  case DisplayItemCustom:
+    break;
+  }
+  return s_views[view].custom;
 }
+#endif
 
-static void inbox_recv_callback(DictionaryIterator *iterator, void *context)
+static void view_mark_dirty(ViewId view)
 {
-  Tuple *temp_tuple = dict_find(iterator, MESSAGE_KEY_CUR_TEMP);
-  Tuple *low_tuple = dict_find(iterator, MESSAGE_KEY_LOW_TEMP);
-  Tuple *high_tuple = dict_find(iterator, MESSAGE_KEY_HIGH_TEMP);
+#if defined(MODULUS_DISPLAY_LIST)
+  display_list_mark_dirty(&s_views[view]);
+#else
+  layer_mark_dirty(view_layer(view));
+#endif
+}
 
-  if (temp_tuple && low_tuple && high_tuple)
+static void view_set_text(ViewId view, const char *text)
+{
+#if defined(MODULUS_DISPLAY_LIST)
+  s_views[view].text = text;
+  display_list_mark_dirty(&s_views[view]);
+#else
+  text_layer_set_text(s_views[view].text, text);
+#endif
+}
+
+static void view_set_text_color(ViewId view, GColor color)
+{
+#if defined(MODULUS_DISPLAY_LIST)
+  s_views[view].color = color;
+  display_list_mark_dirty(&s_views[view]);
+#else
+  text_layer_set_text_color(s_views[view].text, color);
+#endif
+}
+
+static void view_set_bitmap(ViewId view, const GBitmap *bitmap)
+{
+#if defined(MODULUS_DISPLAY_LIST)
+  s_views[view].bitmap = bitmap;
+  display_list_mark_dirty(&s_views[view]);
+#else
+  bitmap_layer_set_bitmap(s_views[view].bitmap, bitmap);
+#endif
+}
+
+static void view_set_hidden(ViewId view, bool hidden)
+{
+#if defined(MODULUS_DISPLAY_LIST)
+  display_list_set_hidden(&s_views[view], hidden);
+#else
+  layer_set_hidden(view_layer(view), hidden);
+#endif
+}
+
+static void views_set_background(GColor color)
+{
+#if defined(MODULUS_DISPLAY_LIST)
+  window_set_background_color(s_window, GColorClear);
+  display_list_set_background(color);
+#else
+  window_set_background_color(s_window, color);
+#endif
+}
+
+// The icons are packed left to right into one atlas resource at build time
+// (see wscript), in the order of the condition indices the phone sends.
+#define WEATHER_ICON_COUNT 6
+#define WEATHER_ICON_DEFAULT 1
+static GBitmap *s_weather_icons[WEATHER_ICON_COUNT];
+
+static int32_t weather_icon_index(int32_t conditions)
+{
+  return conditions >= 0 && conditions < WEATHER_ICON_COUNT ? conditions : WEATHER_ICON_DEFAULT;
+}
+
+static void settings_set_v2_defaults()
+{
+  s_settings.low_power_level = 20;
+  s_settings.quiet_start = 0;
+  s_settings.quiet_end = 0;
+}
+
+static void settings_set_v3_defaults()
+{
+  s_settings.weather_updated = 0;
+}
+
+static void settings_set_defaults()
+{
+  memset(&s_settings, 0, sizeof(s_settings));
+  s_settings.version = SETTINGS_VERSION;
+  s_settings.background_color = GColorBlack;
+  s_settings.accent_color = GColorMediumAquamarine;
+  s_settings.health_outer_arc_color = s_settings.accent_color;
+  s_settings.health_middle_arc_color = s_settings.accent_color;
+  s_settings.health_inner_arc_color = s_settings.accent_color;
+  s_settings.step_goal = 5000;
+  s_settings.move_goal = 30;
+  s_settings.active_goal = 300;
+  s_settings.weather_update_interval = 30;
+  s_settings.weather_index = 0;
+  s_settings.temperature = 20;
+  s_settings.low_temp = 15;
+  s_settings.high_temp = 25;
+  snprintf(s_settings.location, sizeof(s_settings.location), "%s", "My Location");
+  settings_set_v2_defaults();
+  settings_set_v3_defaults();
+}
+
+// Versions up to 1.27 stored one persist key per message key. Message keys
+// are variables generated by the SDK, so the table holds their addresses.
+static const uint32_t *const LEGACY_SETTINGS_KEYS[] = {
+    &MESSAGE_KEY_UPDATE_INTERVAL,
+    &MESSAGE_KEY_BACKGROUND_COLOUR,
+    &MESSAGE_KEY_ACCENT_COLOUR,
+    &MESSAGE_KEY_HEALTH_OUTER_ARC_COLOUR,
+    &MESSAGE_KEY_HEALTH_MIDDLE_ARC_COLOUR,
+    &MESSAGE_KEY_HEALTH_INNER_ARC_COLOUR,
+    &MESSAGE_KEY_STEP_GOAL,
+    &MESSAGE_KEY_MOVE_GOAL,
+    &MESSAGE_KEY_CAL_GOAL,
+    &MESSAGE_KEY_CONDITIONS,
+    &MESSAGE_KEY_LOCATION_NAME,
+    &MESSAGE_KEY_CUR_TEMP,
+    &MESSAGE_KEY_LOW_TEMP,
+    &MESSAGE_KEY_HIGH_TEMP,
+};
+
+static void settings_migrate_legacy_keys()
+{
+  if (persist_exists(MESSAGE_KEY_UPDATE_INTERVAL))
+  {
+    s_settings.weather_update_interval = persist_read_int(MESSAGE_KEY_UPDATE_INTERVAL);
+  }
+  if (persist_exists(MESSAGE_KEY_BACKGROUND_COLOUR))
+  {
+    s_settings.background_color = GColorFromHEX(persist_read_int(MESSAGE_KEY_BACKGROUND_COLOUR));
+  }
+  if (persist_exists(MESSAGE_KEY_ACCENT_COLOUR))
+  {
+    s_settings.accent_color = GColorFromHEX(persist_read_int(MESSAGE_KEY_ACCENT_COLOUR));
+  }
+  s_settings.health_outer_arc_color = s_settings.accent_color;
+  s_settings.health_middle_arc_color = s_settings.accent_color;
+  s_settings.health_inner_arc_color = s_settings.accent_color;
+  if (persist_exists(MESSAGE_KEY_HEALTH_OUTER_ARC_COLOUR))
+  {
+    s_settings.health_outer_arc_color = GColorFromHEX(persist_read_int(MESSAGE_KEY_HEALTH_OUTER_ARC_COLOUR));
+  }
+  if (persist_exists(MESSAGE_KEY_HEALTH_MIDDLE_ARC_COLOUR))
+  {
+    s_settings.health_middle_arc_color = GColorFromHEX(persist_read_int(MESSAGE_KEY_HEALTH_MIDDLE_ARC_COLOUR));
+  }
+  if (persist_exists(MESSAGE_KEY_HEALTH_INNER_ARC_COLOUR))
+  {
+    s_settings.health_inner_arc_color = GColorFromHEX(persist_read_int(MESSAGE_KEY_HEALTH_INNER_ARC_COLOUR));
+  }
+  if (persist_exists(MESSAGE_KEY_STEP_GOAL))
+  {
+    s_settings.step_goal = persist_read_int(MESSAGE_KEY_STEP_GOAL);
+  }
+  if (persist_exists(MESSAGE_KEY_MOVE_GOAL))
   {
-    temperature = temp_tuple->value->int32;
-    low_temp = low_tuple->value->int32;
-    high_temp = high_tuple->value->int32;
-    persist_write_int(MESSAGE_KEY_CUR_TEMP, temperature);
-    persist_write_int(MESSAGE_KEY_LOW_TEMP, low_temp);
-    persist_write_int(MESSAGE_KEY_HIGH_TEMP, high_temp);
-    snprintf(temp_buffer, sizeof(temp_buffer), "%d", (int)temperature);
-    snprintf(low_buffer, sizeof(low_buffer), "%d", (int)low_temp);
-    snprintf(high_buffer, sizeof(high_buffer), "%d", (int)high_temp);
-    text_layer_set_text(s_temperature_layer, temp_buffer);
-    text_layer_set_text(s_low_layer, low_buffer);
-    text_layer_set_text(s_high_layer, high_buffer);
+    s_settings.move_goal = persist_read_int(MESSAGE_KEY_MOVE_GOAL);
   }
+  if (persist_exists(MESSAGE_KEY_CAL_GOAL))
+  {
+    s_settings.active_goal = persist_read_int(MESSAGE_KEY_CAL_GOAL);
+  }
+  if (persist_exists(MESSAGE_KEY_CONDITIONS))
+  {
+    s_settings.weather_index = persist_read_int(MESSAGE_KEY_CONDITIONS);
+  }
+  if (persist_exists(MESSAGE_KEY_LOCATION_NAME))
+  {
+    persist_read_string(MESSAGE_KEY_LOCATION_NAME, s_settings.location, sizeof(s_settings.location));
+  }
+  if (persist_exists(MESSAGE_KEY_CUR_TEMP))
+  {
+    s_settings.temperature = persist_read_int(MESSAGE_KEY_CUR_TEMP);
+  }
+  if (persist_exists(MESSAGE_KEY_LOW_TEMP))
+  {
+    s_settings.low_temp = persist_read_int(MESSAGE_KEY_LOW_TEMP);
+  }
+  if (persist_exists(MESSAGE_KEY_HIGH_TEMP))
+  {
+    s_settings.high_temp = persist_read_int(MESSAGE_KEY_HIGH_TEMP);
+  }
+}
 
-  Tuple *conditions_tuple = dict_find(iterator, MESSAGE_KEY_CONDITIONS);
-  if (conditions_tuple)
+// Writes the blob back only if it differs from what is already in flash.
+static void settings_save()
+{
+  if (memcmp(&s_settings, &s_stored_settings, sizeof(s_settings)) == 0)
   {
-    weather_index = conditions_tuple->value->int32;
-    persist_write_int(MESSAGE_KEY_CONDITIONS, weather_index);
-    gbitmap_destroy(s_condition_bitmap);
-    s_condition_bitmap = gbitmap_create_with_resource(WEATHER_ICONS[weather_index]);
-    bitmap_layer_set_bitmap(s_condition_layer, s_condition_bitmap);
-    layer_mark_dirty(bitmap_layer_get_layer(s_condition_layer));
+    return;
   }
+  if (persist_write_data(SETTINGS_KEY, &s_settings, sizeof(s_settings)) == (int)sizeof(s_settings))
+  {
+    s_stored_settings = s_settings;
+  }
+}
 
-  Tuple *location_tuple = dict_find(iterator, MESSAGE_KEY_LOCATION);
-  if (location_tuple)
+static void settings_read()
+{
+  const int read = persist_read_data(SETTINGS_KEY, &s_settings, sizeof(s_settings));
+  if (read == (int)sizeof(s_settings) && s_settings.version == SETTINGS_VERSION)
+  {
+    s_stored_settings = s_settings;
+    return;
+  }
+  if ((read == (int)SETTINGS_V1_SIZE && s_settings.version == 1) ||
+      (read == (int)SETTINGS_V2_SIZE && s_settings.version == 2))
   {
-    snprintf(location, sizeof(location), "%s", location_tuple->value->cstring);
-    persist_write_string(MESSAGE_KEY_LOCATION_NAME, location_tuple->value->cstring);
-    text_layer_set_text(s_loc_layer, location);
+    if (s_settings.version < 2)
+    {
+      settings_set_v2_defaults();
+    }
+    settings_set_v3_defaults();
+    s_settings.version = SETTINGS_VERSION;
+    memset(&s_stored_settings, 0, sizeof(s_stored_settings));
+    settings_save();
+    return;
   }
 
-  Tuple *update_interval_tuple = dict_find(iterator, MESSAGE_KEY_UPDATE_INTERVAL);
-  if (update_interval_tuple)
+  settings_set_defaults();
+  settings_migrate_legacy_keys();
+  memset(&s_stored_settings, 0, sizeof(s_stored_settings));
+  settings_save();
+  for (size_t i = 0; i < ARRAY_LENGTH(LEGACY_SETTINGS_KEYS); i++)
   {
-    weather_update_interval = update_interval_tuple->value->int32;
-    persist_write_int(MESSAGE_KEY_UPDATE_INTERVAL, weather_update_interval);
+    persist_delete(*LEGACY_SETTINGS_KEYS[i]);
   }
+}
+
+static void settings_load()
+{
+  settings_read();
+  // Neither the blob nor the legacy keys are checked when written, and the
+  // index picks an entry of s_weather_icons.
+  s_settings.weather_index = weather_icon_index(s_settings.weather_index);
+}
 
-  Tuple *api_key = dict_find(iterator, MESSAGE_KEY_OWM_API_KEY);
-  if (api_key)
+// Health totals are kept as a full-day sum up to s_health_checkpoint plus a
+// short window after it. Movement updates only re-sum the window, which is
+// folded into the base once it grows past HEALTH_WINDOW_SECONDS, so no event
+// scans more than a few minutes of records. The checkpoint sits on a minute
+// boundary so no minute record is counted twice, and trails the clock by a
+// couple of minutes so records still being written are not folded early.
+#define HEALTH_METRIC_COUNT 3
+#define HEALTH_WINDOW_SECONDS (15 * 60)
+#define HEALTH_SETTLE_SECONDS (2 * 60)
+
+static const HealthMetric HEALTH_METRICS[HEALTH_METRIC_COUNT] = {
+    HealthMetricStepCount,
+    HealthMetricActiveSeconds,
+    HealthMetricActiveKCalories,
+};
+static HealthValue s_health_base[HEALTH_METRIC_COUNT];
+static time_t s_health_checkpoint;
+static bool s_health_events = false;
+
+static void apply_health_totals(const HealthValue window[HEALTH_METRIC_COUNT])
+{
+  step_count = s_health_base[0] + window[0];
+  move_minutes = (s_health_base[1] + window[1]) / 60;
+  active_calories = s_health_base[2] + window[2];
+}
+
+static time_t health_checkpoint_for(time_t now)
+{
+  time_t checkpoint = now - HEALTH_SETTLE_SECONDS;
+  checkpoint -= checkpoint % 60;
+  return checkpoint < time_start_of_today() ? time_start_of_today() : checkpoint;
+}
+
+// Full re-sum of today, used at startup, at midnight and when the firmware
+// reports a significant update (e.g. after a sync or a backfill).
+static void update_health_metrics()
+{
+  const time_t now = time(NULL);
+  s_health_checkpoint = health_checkpoint_for(now);
+  HealthValue window[HEALTH_METRIC_COUNT];
+  for (int i = 0; i < HEALTH_METRIC_COUNT; i++)
   {
-    request_weather();
+    s_health_base[i] = health_service_sum(HEALTH_METRICS[i], time_start_of_today(), s_health_checkpoint);
+    window[i] = health_service_sum(HEALTH_METRICS[i], s_health_checkpoint, now + 1);
   }
+  apply_health_totals(window);
+}
 
-  Tuple *bg_colour_tuple = dict_find(iterator, MESSAGE_KEY_BACKGROUND_COLOUR);
-  if (bg_colour_tuple)
+static void update_health_window()
+{
+  const time_t now = time(NULL);
+  HealthValue window[HEALTH_METRIC_COUNT];
+  for (int i = 0; i < HEALTH_METRIC_COUNT; i++)
   {
-    background_color = GColorFromHEX(bg_colour_tuple->value->int32);
-    persist_write_int(MESSAGE_KEY_BACKGROUND_COLOUR, bg_colour_tuple->value->int32);
-    text_color = gcolor_legible_over(background_color);
-    window_set_background_color(s_window, background_color);
-    text_layer_set_text_color(s_time_layer, text_color);
-    text_layer_set_text_color(s_date_layer, text_color);
-    text_layer_set_text_color(s_loc_layer, text_color);
-    text_layer_set_text_color(s_temperature_layer, text_color);
+    window[i] = health_service_sum(HEALTH_METRICS[i], s_health_checkpoint, now + 1);
   }
+  apply_health_totals(window);
 
-  Tuple *accent_colour_tuple = dict_find(iterator, MESSAGE_KEY_ACCENT_COLOUR);
-  if (accent_colour_tuple)
+  const time_t checkpoint = health_checkpoint_for(now);
+  if (checkpoint - s_health_checkpoint < HEALTH_WINDOW_SECONDS)
   {
-    accent_color = GColorFromHEX(accent_colour_tuple->value->int32);
-    persist_write_int(MESSAGE_KEY_ACCENT_COLOUR, accent_colour_tuple->value->int32);
-    text_layer_set_text_color(s_low_layer, accent_color);
-    text_layer_set_text_color(s_high_layer, accent_color);
-    text_layer_set_text_color(s_day_layer, accent_color);
-    layer_mark_dirty(s_temp_arc_layer);
-    layer_mark_dirty(s_health_layer);
-    layer_mark_dirty(s_battery_layer);
+    return;
   }
+  for (int i = 0; i < HEALTH_METRIC_COUNT; i++)
+  {
+    s_health_base[i] += health_service_sum(HEALTH_METRICS[i], s_health_checkpoint, checkpoint);
+  }
+  s_health_checkpoint = checkpoint;
+}
 
-  Tuple *health_outer_arc_colour_tuple = dict_find(iterator, MESSAGE_KEY_HEALTH_OUTER_ARC_COLOUR);
-  if (health_outer_arc_colour_tuple)
+static void mark_health_dirty_if_changed()
+{
+  const bool goals_met = step_count >= s_settings.step_goal && move_minutes >= s_settings.move_goal && active_calories >= s_settings.active_goal;
+  const int32_t step_arc = arc_steps(step_count, s_settings.step_goal);
+  const int32_t move_arc = arc_steps(move_minutes, s_settings.move_goal);
+  const int32_t active_arc = arc_steps(active_calories, s_settings.active_goal);
+
+  if (goals_met == s_rendered.goals_met &&
+      step_arc == s_rendered.step_arc &&
+      move_arc == s_rendered.move_arc &&
+      active_arc == s_rendered.active_arc)
   {
-    health_outer_arc_color = GColorFromHEX(health_outer_arc_colour_tuple->value->int32);
-    persist_write_int(MESSAGE_KEY_HEALTH_OUTER_ARC_COLOUR, health_outer_arc_colour_tuple->value->int32);
-    layer_mark_dirty(s_health_layer);
+    return;
   }
+  s_rendered.goals_met = goals_met;
+  s_rendered.step_arc = step_arc;
+  s_rendered.move_arc = move_arc;
+  s_rendered.active_arc = active_arc;
+  view_mark_dirty(VIEW_HEALTH);
+}
+
+// Power governor: at or below the configured charge level, or during quiet
+// hours, the face saves power until it is charging or the hours are over.
+// Weather is fetched POWER_SAVING_WEATHER_FACTOR times less often, health is
+// no longer re-queried every minute and the ring widgets are hidden.
+#define POWER_SAVING_WEATHER_FACTOR 4
+
+static struct
+{
+  bool saving;
+  bool charging;
+} s_power;
 
-  Tuple *health_middle_arc_colour_tuple = dict_find(iterator, MESSAGE_KEY_HEALTH_MIDDLE_ARC_COLOUR);
-  if (health_middle_arc_colour_tuple)
+// Quiet hours run from quiet_start up to quiet_end and may wrap past
+// midnight; equal hours turn them off.
+static bool in_quiet_hours(int hour)
+{
+  const int start = s_settings.quiet_start;
+  const int end = s_settings.quiet_end;
+  if (start == end)
   {
-    health_middle_arc_color = GColorFromHEX(health_middle_arc_colour_tuple->value->int32);
-    persist_write_int(MESSAGE_KEY_HEALTH_MIDDLE_ARC_COLOUR, health_middle_arc_colour_tuple->value->int32);
-    layer_mark_dirty(s_health_layer);
+    return false;
   }
+  return start < end ? hour >= start && hour < end : hour >= start || hour < end;
+}
 
-  Tuple *health_inner_arc_colour_tuple = dict_find(iterator, MESSAGE_KEY_HEALTH_INNER_ARC_COLOUR);
-  if (health_inner_arc_colour_tuple)
+static void power_update(const struct tm *tick_time)
+{
+  const bool low_battery = s_settings.low_power_level && battery_level <= s_settings.low_power_level;
+  const bool saving = !s_power.charging && (low_battery || in_quiet_hours(tick_time->tm_hour));
+  if (saving == s_power.saving)
   {
-    health_inner_arc_color = GColorFromHEX(health_inner_arc_colour_tuple->value->int32);
-    persist_write_int(MESSAGE_KEY_HEALTH_INNER_ARC_COLOUR, health_inner_arc_colour_tuple->value->int32);
-    layer_mark_dirty(s_health_layer);
+    return;
   }
+  s_power.saving = saving;
+  view_set_hidden(VIEW_TEMPERATURE_ARC, saving);
+  view_set_hidden(VIEW_HEALTH, saving);
+  view_set_hidden(VIEW_STEP_HISTORY, saving);
+  if (!saving)
+  {
+    // Catch up on health; the next tick catches up on weather.
+    update_health_metrics();
+    mark_health_dirty_if_changed();
+  }
+}
 
-  Tuple *step_goal_tuple = dict_find(iterator, MESSAGE_KEY_STEP_GOAL);
-  if (step_goal_tuple)
+static void power_update_now()
+{
+  const time_t now = time(NULL);
+  power_update(localtime(&now));
+}
+
+// The ring geometry behind the arcs only depends on the colours, so it is
+// drawn once, copied out of the frame buffer and blitted on later frames.
+// Views are laid out in window coordinates, so a view's frame is also its
+// position in the frame buffer.
+static GBitmap *ring_cache_capture(GRect frame, GContext *ctx)
+{
+  GBitmap *frame_buffer = graphics_capture_frame_buffer(ctx);
+  if (!frame_buffer)
   {
-    step_goal = step_goal_tuple->value->int32;
-    persist_write_int(MESSAGE_KEY_STEP_GOAL, step_goal);
+    return NULL;
   }
 
-  Tuple *move_goal_tuple = dict_find(iterator, MESSAGE_KEY_MOVE_GOAL);
-  if (move_goal_tuple)
+  GBitmap *cache = NULL;
+  const GRect screen = gbitmap_get_bounds(frame_buffer);
+  if (frame.origin.x >= 0 && frame.origin.y >= 0 &&
+      frame.origin.x + frame.size.w <= screen.size.w &&
+      frame.origin.y + frame.size.h <= screen.size.h)
   {
-    move_goal = move_goal_tuple->value->int32;
-    persist_write_int(MESSAGE_KEY_MOVE_GOAL, move_goal);
+    const GBitmapFormat format = gbitmap_get_format(frame_buffer);
+    cache = gbitmap_create_blank(frame.size, format);
   }
+  if (cache)
+  {
+    const uint8_t *src = gbitmap_get_data(frame_buffer);
+    const uint16_t src_stride = gbitmap_get_bytes_per_row(frame_buffer);
+    uint8_t *dst = gbitmap_get_data(cache);
+    const uint16_t dst_stride = gbitmap_get_bytes_per_row(cache);
+    for (int16_t y = 0; y < frame.size.h; y++)
+    {
+      const uint8_t *src_row = src + (frame.origin.y + y) * src_stride;
+      uint8_t *dst_row = dst + y * dst_stride;
+      if (gbitmap_get_format(cache) == GBitmapFormat8Bit)
+      {
+        memcpy(dst_row, src_row + frame.origin.x, frame.size.w);
+        continue;
+      }
+      // 1-bit frame buffers pack pixels LSB first and layers need not start
+      // on a byte boundary.
+      for (int16_t x = 0; x < frame.size.w; x++)
+      {
+        const int16_t src_x = frame.origin.x + x;
+        if (src_row[src_x / 8] & (1 << (src_x % 8)))
+        {
+          dst_row[x / 8] |= 1 << (x % 8);
+        }
+      }
+    }
+  }
+  graphics_release_frame_buffer(ctx, frame_buffer);
+  // The caches are the only allocations made while drawing.
+  perf_heap_sample();
+  return cache;
+}
 
-  Tuple *active_goal_tuple = dict_find(iterator, MESSAGE_KEY_CAL_GOAL);
-  if (active_goal_tuple)
+static void ring_cache_invalidate()
+{
+  if (s_temperature_ring_cache)
+  {
+    gbitmap_destroy(s_temperature_ring_cache);
+    s_temperature_ring_cache = NULL;
+  }
+  if (s_health_ring_cache)
   {
-    active_goal = active_goal_tuple->value->int32;
-    persist_write_int(MESSAGE_KEY_CAL_GOAL, active_goal);
+    gbitmap_destroy(s_health_ring_cache);
+    s_health_ring_cache = NULL;
   }
+}
+
+static void ring_cache_draw(GContext *ctx, GRect frame, GBitmap *cache)
+{
+  graphics_context_set_compositing_mode(ctx, GCompOpAssign);
+  graphics_draw_bitmap_in_rect(ctx, cache, frame);
+}
+
+// Message kinds for the outbox queue.
+enum
+{
+  OUTBOX_WEATHER_REQUEST,
+  OUTBOX_PERF,
+};
 
-  if (step_goal_tuple || move_goal_tuple || active_goal_tuple)
+// Weather requests go through a small scheduler: at most one request in
+// flight, nothing sent while the phone is unreachable or the last reply is
+// still fresh, and exponential backoff with jitter after a failed send or a
+// reply that never comes.
+#define WEATHER_REQUEST_KEY 0
+#define WEATHER_REPLY_TIMEOUT_SECONDS (2 * 60)
+#define WEATHER_BACKOFF_BASE_SECONDS 60
+#define WEATHER_BACKOFF_MAX_SECONDS (60 * 60)
+#define WEATHER_BACKOFF_MAX_FAILURES 7
+// While the hourly forecast reaches this far ahead it keeps the face
+// current, so fetches can be this far apart whatever the interval setting.
+#define WEATHER_FORECAST_REFRESH_SECONDS (3 * 60 * 60)
+
+static struct
+{
+  bool in_flight;
+  time_t requested_at;
+  time_t retry_at;
+  uint8_t failures;
+} s_weather;
+
+static void weather_request_failed()
+{
+  s_weather.in_flight = false;
+  if (s_weather.failures < WEATHER_BACKOFF_MAX_FAILURES)
   {
-    layer_mark_dirty(s_health_layer);
+    s_weather.failures++;
   }
+  int32_t delay = WEATHER_BACKOFF_BASE_SECONDS << (s_weather.failures - 1);
+  if (delay > WEATHER_BACKOFF_MAX_SECONDS)
+  {
+    delay = WEATHER_BACKOFF_MAX_SECONDS;
+  }
+  delay += rand() % (delay / 2 + 1);
+  s_weather.retry_at = time(NULL) + delay;
 }
 
-static void inbox_dropped_callback(AppMessageResult reason, void *context)
+static void weather_request_succeeded()
 {
-  APP_LOG(APP_LOG_LEVEL_ERROR, "Message dropped!");
+  s_weather.in_flight = false;
+  s_weather.failures = 0;
+  s_weather.retry_at = 0;
+  s_settings.weather_updated = time(NULL);
 }
 
-static void outbox_failed_callback(DictionaryIterator *iterator, AppMessageResult reason, void *context)
+static void weather_reset_backoff()
 {
-  APP_LOG(APP_LOG_LEVEL_ERROR, "Outbox send failed!");
+  s_weather.in_flight = false;
+  s_weather.failures = 0;
+  s_weather.retry_at = 0;
 }
 
-static void outbox_sent_callback(DictionaryIterator *iterator, void *context)
+static void weather_request_write(DictionaryIterator *iter)
 {
-  APP_LOG(APP_LOG_LEVEL_INFO, "Outbox send success!");
+  dict_write_uint8(iter, WEATHER_REQUEST_KEY, 0);
 }
 
-static void update_health_metrics()
+static void weather_request_done(AppMessageResult result)
 {
-  step_count = health_service_sum_today(HealthMetricStepCount);
-  move_minutes = health_service_sum_today(HealthMetricActiveSeconds) / 60;
-  active_calories = health_service_sum_today(HealthMetricActiveKCalories);
+  if (result != APP_MSG_OK)
+  {
+    weather_request_failed();
+  }
 }
 
-static void update_time()
+static void request_weather()
 {
-  time_t temp = time(NULL);
-  struct tm *tick_time = localtime(&temp);
-  static char time_buffer[] = "00:00";
+  outbox_queue(OUTBOX_WEATHER_REQUEST, weather_request_write, weather_request_done);
+  s_weather.in_flight = true;
+  s_weather.requested_at = time(NULL);
+  perf_weather_requested();
+}
 
-  strftime(time_buffer, sizeof(time_buffer), clock_is_24h_style() ? "%H:%M" : "%I:%M", tick_time);
-  text_layer_set_text(s_time_layer, time_buffer);
+// Sends a request once the last reply is older than the update interval,
+// which stretches while the stored forecast covers the next hours and in
+// power saving. Nothing is sent while a request is in flight, during
+// backoff or without a phone connection. Settings that change the weather
+// are refetched by the phone when they are saved.
+static void schedule_weather()
+{
+  const time_t now = time(NULL);
+  if (s_weather.in_flight && now - s_weather.requested_at >= WEATHER_REPLY_TIMEOUT_SECONDS)
+  {
+    perf_weather_timed_out();
+    weather_request_failed();
+  }
+  if (s_weather.in_flight || now < s_weather.retry_at || !connection_service_peek_pebble_app_connection())
+  {
+    return;
+  }
+  int32_t interval = s_settings.weather_update_interval * 60;
+  if (interval < WEATHER_FORECAST_REFRESH_SECONDS && forecast_covers(now + WEATHER_FORECAST_REFRESH_SECONDS))
+  {
+    interval = WEATHER_FORECAST_REFRESH_SECONDS;
+  }
+  if (s_power.saving)
+  {
+    interval *= POWER_SAVING_WEATHER_FACTOR;
+  }
+  const time_t updated = s_settings.weather_updated;
+  if (updated && now >= updated && now - updated < interval)
+  {
+    return;
+  }
+  request_weather();
+}
 
-  static char day_buffer[] = "Mon";
-  strftime(day_buffer, sizeof(day_buffer), "%a", tick_time);
-  text_layer_set_text(s_day_layer, day_buffer);
+// Packed when it goes out, so a dump that waited behind a weather request
+// still has the latest counters.
+static void perf_write(DictionaryIterator *iter)
+{
+  uint8_t payload[PERF_PAYLOAD_SIZE];
+  const size_t length = perf_pack(payload, sizeof(payload));
+  dict_write_data(iter, MESSAGE_KEY_PERF, payload, length);
+}
 
-  static char date_buffer[] = "01";
-  strftime(date_buffer, sizeof(date_buffer), "%d", tick_time);
-  text_layer_set_text(s_date_layer, date_buffer);
+static void send_perf()
+{
+  outbox_queue(OUTBOX_PERF, perf_write, NULL);
 }
 
-static void tick_handler(struct tm *tick_time, TimeUnits units_changed)
+static void weather_icons_load()
 {
-  if (tick_time->tm_min % weather_update_interval == 0)
+  s_weather_atlas = gbitmap_create_with_resource(RESOURCE_ID_WEATHER_ICONS);
+  const GRect atlas_bounds = gbitmap_get_bounds(s_weather_atlas);
+  const int16_t icon_width = atlas_bounds.size.w / WEATHER_ICON_COUNT;
+  for (int i = 0; i < WEATHER_ICON_COUNT; i++)
   {
-    request_weather();
+    s_weather_icons[i] = gbitmap_create_as_sub_bitmap(s_weather_atlas, GRect(i * icon_width, 0, icon_width, atlas_bounds.size.h));
   }
-  update_time();
-  update_health_metrics();
-  layer_mark_dirty(s_health_layer);
 }
 
-static void temperature_update_proc(Layer *layer, GContext *ctx)
+static void weather_icons_unload()
 {
-  graphics_context_set_stroke_width(ctx, 4);
-  graphics_context_set_fill_color(ctx, accent_color);
-  graphics_fill_radial(ctx, GRect(0, 0, arc_width, arc_width), GOvalScaleModeFitCircle, 5, 0, DEG_TO_TRIGANGLE(360));
-  graphics_context_set_fill_color(ctx, background_color);
-  graphics_fill_radial(ctx, GRect(0, 0, arc_width + 1, arc_width + 1), GOvalScaleModeFitCircle, 7, DEG_TO_TRIGANGLE(127), DEG_TO_TRIGANGLE(233));
-  int cur_temp = temperature;
-  if (cur_temp < low_temp)
+  for (int i = 0; i < WEATHER_ICON_COUNT; i++)
   {
-    cur_temp = low_temp;
+    gbitmap_destroy(s_weather_icons[i]);
+    s_weather_icons[i] = NULL;
   }
-  if (cur_temp > high_temp)
+  gbitmap_destroy(s_weather_atlas);
+  s_weather_atlas = NULL;
+}
+
+// Weather arrives as one byte array under MESSAGE_KEY_WEATHER, packed by
+// packWeather() in src/pkjs/index.js:
+//   [0]     format version, WEATHER_PAYLOAD_VERSION
+//   [1..6]  current, high and low temperature, int16 little-endian
+//   [7]     condition index in the low nibble, high nibble reserved
+//   [8]     location length N, followed by N bytes of UTF-8, unterminated
+#define WEATHER_PAYLOAD_VERSION 1
+#define WEATHER_PAYLOAD_HEADER_SIZE 9
+#define WEATHER_CONDITIONS_UNKNOWN 0x0F
+
+typedef struct
+{
+  int16_t temperature;
+  int16_t high_temp;
+  int16_t low_temp;
+  uint8_t conditions;
+  uint8_t location_length;
+  const char *location;
+} WeatherPayload;
+
+static int16_t read_int16_le(const uint8_t *data)
+{
+  return (int16_t)(data[0] | (data[1] << 8));
+}
+
+static bool weather_payload_decode(const Tuple *tuple, WeatherPayload *weather)
+{
+  if (tuple->type != TUPLE_BYTE_ARRAY || tuple->length < WEATHER_PAYLOAD_HEADER_SIZE)
   {
-    cur_temp = high_temp;
+    return false;
   }
-  float relative_temp = (float)(cur_temp - low_temp) / (float)(high_temp - low_temp);
-  float angle = 235 + (485 - 235) * relative_temp;
-  int x = (int)(arc_width / 2 + (arc_width / 2 - 2) * sin_lookup(DEG_TO_TRIGANGLE(angle)) / TRIG_MAX_RATIO);
-  int y = (int)(arc_width / 2 - (arc_width / 2 - 2) * cos_lookup(DEG_TO_TRIGANGLE(angle)) / TRIG_MAX_RATIO);
-  graphics_context_set_fill_color(ctx, background_color);
-  graphics_fill_circle(ctx, GPoint(x, y), 4);
-  graphics_context_set_fill_color(ctx, text_color);
-  graphics_fill_circle(ctx, GPoint(x, y), 2);
+  const uint8_t *data = tuple->value->data;
+  if (data[0] != WEATHER_PAYLOAD_VERSION)
+  {
+    return false;
+  }
+  weather->temperature = read_int16_le(&data[1]);
+  weather->high_temp = read_int16_le(&data[3]);
+  weather->low_temp = read_int16_le(&data[5]);
+  weather->conditions = data[7] & 0x0F;
+  weather->location_length = data[8];
+  weather->location = (const char *)&data[WEATHER_PAYLOAD_HEADER_SIZE];
+  return WEATHER_PAYLOAD_HEADER_SIZE + weather->location_length <= tuple->length;
 }
 
-static void health_update_proc(Layer *layer, GContext *ctx)
+// The weather widgets show the current location, whose weather lives in
+// s_settings, or a saved place a wrist tap moved to: 0 is the current
+// location and n the saved place n - 1.
+static uint8_t s_place_shown;
+
+static void show_temperatures(int32_t temperature, int32_t low_temp, int32_t high_temp)
 {
-  if (step_count < step_goal || move_minutes < move_goal || active_calories < active_goal)
+  if (s_rendered.temperatures_shown &&
+      temperature == s_rendered.temperature &&
+      low_temp == s_rendered.low_temp &&
+      high_temp == s_rendered.high_temp)
   {
-    // Draw background circles
-    graphics_context_set_fill_color(ctx, GColorDarkGray);
-    graphics_fill_radial(ctx, GRect(0, 0, arc_width, arc_width), GOvalScaleModeFitCircle, 5, 0, DEG_TO_TRIGANGLE(360));
-    graphics_fill_radial(ctx, GRect(7, 7, arc_width - 14, arc_width - 14), GOvalScaleModeFitCircle, 5, 0, DEG_TO_TRIGANGLE(360));
-    graphics_fill_radial(ctx, GRect(14, 14, arc_width - 28, arc_width - 28), GOvalScaleModeFitCircle, 5, 0, DEG_TO_TRIGANGLE(360));
+    return;
+  }
+  s_rendered.temperatures_shown = true;
+  s_rendered.temperature = temperature;
+  s_rendered.low_temp = low_temp;
+  s_rendered.high_temp = high_temp;
+  snprintf(temp_buffer, sizeof(temp_buffer), "%d", (int)temperature);
+  snprintf(low_buffer, sizeof(low_buffer), "%d", (int)low_temp);
+  snprintf(high_buffer, sizeof(high_buffer), "%d", (int)high_temp);
+  view_set_text(VIEW_TEMPERATURE, temp_buffer);
+  view_set_text(VIEW_LOW, low_buffer);
+  view_set_text(VIEW_HIGH, high_buffer);
+}
 
-    // Draw progress arcs
-    graphics_context_set_fill_color(ctx, health_outer_arc_color);
-    float step_angle = ((float)step_count / (float)step_goal * 360.0);
-    graphics_fill_radial(ctx, GRect(0, 0, arc_width, arc_width), GOvalScaleModeFitCircle, 5, 0, DEG_TO_TRIGANGLE((int)step_angle));
+static void show_weather_icon(int32_t weather_index)
+{
+  if (weather_index != s_rendered.weather_index)
+  {
+    s_rendered.weather_index = weather_index;
+    view_set_bitmap(VIEW_CONDITION, s_weather_icons[weather_index]);
+  }
+}
 
-    graphics_context_set_fill_color(ctx, health_middle_arc_color);
-    float move_angle = ((float)move_minutes / (float)move_goal * 360.0);
-    graphics_fill_radial(ctx, GRect(7, 7, arc_width - 14, arc_width - 14), GOvalScaleModeFitCircle, 5, 0, DEG_TO_TRIGANGLE((int)move_angle));
+// Shows the current location or the saved place s_place_shown points at,
+// all from what the watch already has.
+static void show_place(time_t now)
+{
+  if (!s_place_shown)
+  {
+    show_temperatures(s_settings.temperature, s_settings.low_temp, s_settings.high_temp);
+    show_weather_icon(s_settings.weather_index);
+    view_set_text(VIEW_LOCATION, s_settings.location);
+    return;
+  }
+  const uint8_t index = s_place_shown - 1;
+  const PlaceWeather weather = places_weather(index, now);
+  show_temperatures(weather.temperature, weather.low_temp, weather.high_temp);
+  show_weather_icon(weather_icon_index(weather.conditions));
+  view_set_text(VIEW_LOCATION, places_name(index));
+}
 
-    graphics_context_set_fill_color(ctx, health_inner_arc_color);
-    float active_angle = ((float)active_calories / (float)active_goal * 360.0);
-    graphics_fill_radial(ctx, GRect(14, 14, arc_width - 28, arc_width - 28), GOvalScaleModeFitCircle, 5, 0, DEG_TO_TRIGANGLE((int)active_angle));
+// Takes new weather for the current location, which is only drawn while no
+// saved place is shown.
+static void here_update(int32_t temperature, int32_t low_temp, int32_t high_temp, uint8_t conditions)
+{
+  s_settings.temperature = temperature;
+  s_settings.low_temp = low_temp;
+  s_settings.high_temp = high_temp;
+  if (conditions != WEATHER_CONDITIONS_UNKNOWN)
+  {
+    s_settings.weather_index = weather_icon_index(conditions);
   }
-  else
+  if (!s_place_shown)
   {
-    // Draw checkmark
-    graphics_context_set_fill_color(ctx, accent_color);
-    graphics_fill_radial(ctx, GRect(0, 0, arc_width, arc_width), GOvalScaleModeFitCircle, 5, 0, DEG_TO_TRIGANGLE(360));
-    gpath_draw_filled(ctx, s_check_path);
+    show_temperatures(temperature, low_temp, high_temp);
+    show_weather_icon(s_settings.weather_index);
   }
 }
 
-static void battery_update_proc(Layer *layer, GContext *ctx)
+// Moves the current location on to the forecast for the current hour,
+// keeping the day's high and low from the last reply. Returns false if
+// there is none.
+static bool forecast_show(time_t now)
 {
-  if (battery_level > 20)
+  const ForecastHour *hour = forecast_current(now);
+  if (!hour)
   {
-    graphics_context_set_fill_color(ctx, accent_color);
+    return false;
   }
-  else
+  here_update(hour->temperature, s_settings.low_temp, s_settings.high_temp, hour->conditions);
+  return true;
+}
+
+static void apply_weather(const WeatherPayload *weather)
+{
+  here_update(weather->temperature, weather->low_temp, weather->high_temp, weather->conditions);
+
+  char location[sizeof(s_settings.location)];
+  const size_t location_length = weather->location_length < sizeof(location) - 1 ? weather->location_length : sizeof(location) - 1;
+  memcpy(location, weather->location, location_length);
+  location[location_length] = '\0';
+  if (strcmp(s_settings.location, location) != 0)
   {
-    graphics_context_set_fill_color(ctx, GColorSunsetOrange);
+    memcpy(s_settings.location, location, sizeof(location));
+    if (!s_place_shown)
+    {
+      view_set_text(VIEW_LOCATION, s_settings.location);
+    }
   }
-  int angle = (int)((float)(100 - battery_level) / 100.0 * 360.0);
-  graphics_fill_radial(ctx, GRect(0, 0, arc_width, arc_width), GOvalScaleModeFitCircle, 5, DEG_TO_TRIGANGLE(angle), DEG_TO_TRIGANGLE(360));
-  gpath_draw_filled(ctx, s_bolt_path);
+
+  weather_request_succeeded();
+  perf_weather_replied();
 }
 
-static void battery_callback(BatteryChargeState state)
+// Setting setters for the inbox: each reports whether the value changed, so
+// a resent setting costs no redraw.
+static bool set_color(GColor *setting, const Tuple *tuple)
 {
-  battery_level = state.charge_percent;
-  layer_mark_dirty(s_battery_layer);
+  const GColor color = GColorFromHEX(tuple->value->int32);
+  if (gcolor_equal(color, *setting))
+  {
+    return false;
+  }
+  *setting = color;
+  return true;
 }
 
-static void main_window_load(Window *window)
+static bool set_uint8(uint8_t *setting, const Tuple *tuple)
 {
-  Layer *window_layer = window_get_root_layer(window);
-  GRect bounds = layer_get_bounds(window_layer);
-  const bool is_emery = PBL_PLATFORM_TYPE_CURRENT == PlatformTypeEmery;
+  const uint8_t value = tuple->value->int32;
+  if (value == *setting)
+  {
+    return false;
+  }
+  *setting = value;
+  return true;
+}
 
-  int16_t widget_offset = bounds.size.h - arc_width - 10;
+// A tap of the wrist steps from the current location through the saved
+// places and back, from the cache and without a message to the phone.
+static void accel_tap_handler(AccelAxisType axis, int32_t direction)
+{
+  if (!places_count())
+  {
+    return;
+  }
+  s_place_shown = (s_place_shown + 1) % (places_count() + 1);
+  show_place(time(NULL));
+}
+
+// Tap events keep the accelerometer service busy, so they are only taken
+// while there is a saved place to step to.
+static bool s_tap_subscribed;
 
-  int16_t time_font_size = PBL_PLATFORM_TYPE_CURRENT == PlatformTypeEmery ? 62 : 52;
-  s_time_layer = text_layer_create(GRect(0, 20, bounds.size.w - PADDING, time_font_size));
-  text_layer_set_text(s_time_layer, "24");
-  text_layer_set_text_alignment(s_time_layer, GTextAlignmentRight);
-  if (is_emery)
+static void accel_tap_update()
+{
+  const bool wanted = places_count() > 0;
+  if (wanted == s_tap_subscribed)
   {
-    text_layer_set_font(s_time_layer, tomorrow_62);
+    return;
+  }
+  s_tap_subscribed = wanted;
+  if (wanted)
+  {
+    accel_tap_service_subscribe(accel_tap_handler);
   }
   else
   {
-    text_layer_set_font(s_time_layer, tomorrow_45);
-  }
-  text_layer_set_text_color(s_time_layer, text_color);
-  text_layer_set_background_color(s_time_layer, GColorClear);
-  layer_add_child(window_layer, text_layer_get_layer(s_time_layer));
-
-  s_day_layer = text_layer_create(GRect(bounds.size.w - 70 - PADDING, is_emery ? -2 : 0, 50, is_emery ? 28 : 21));
-  text_layer_set_text(s_day_layer, "");
-  text_layer_set_text_alignment(s_day_layer, GTextAlignmentRight);
-  text_layer_set_font(s_day_layer, fonts_get_system_font(is_emery ? FONT_KEY_GOTHIC_24_BOLD : FONT_KEY_GOTHIC_18_BOLD));
-  text_layer_set_text_color(s_day_layer, accent_color);
-  text_layer_set_background_color(s_day_layer, GColorClear);
-  layer_add_child(window_layer, text_layer_get_layer(s_day_layer));
-
-  s_date_layer = text_layer_create(GRect(PADDING, is_emery ? -2 : 0, bounds.size.w - PADDING * 2, is_emery ? 28 : 21));
-  text_layer_set_text(s_date_layer, "");
-  text_layer_set_text_alignment(s_date_layer, GTextAlignmentRight);
-  text_layer_set_font(s_date_layer, fonts_get_system_font(is_emery ? FONT_KEY_GOTHIC_24_BOLD : FONT_KEY_GOTHIC_18_BOLD));
-  text_layer_set_text_color(s_date_layer, text_color);
-  text_layer_set_background_color(s_date_layer, GColorClear);
-  layer_add_child(window_layer, text_layer_get_layer(s_date_layer));
-
-  s_condition_layer = bitmap_layer_create(GRect(PADDING + 5, widget_offset - 30, 21, 21));
-  s_condition_bitmap = gbitmap_create_with_resource(WEATHER_ICONS[weather_index]);
-  bitmap_layer_set_bitmap(s_condition_layer, s_condition_bitmap);
-  bitmap_layer_set_alignment(s_condition_layer, GAlignCenter);
-  bitmap_layer_set_compositing_mode(s_condition_layer, GCompOpSet);
-  layer_add_child(window_layer, bitmap_layer_get_layer(s_condition_layer));
-
-  s_loc_layer = text_layer_create(GRect(PADDING + 30, is_emery ? widget_offset - 36 : widget_offset - 30, bounds.size.w - PADDING - 30, is_emery ? 28 : 21));
-  text_layer_set_text(s_loc_layer, location);
-  text_layer_set_text_alignment(s_loc_layer, GTextAlignmentLeft);
-  text_layer_set_overflow_mode(s_loc_layer, GTextOverflowModeTrailingEllipsis);
-  text_layer_set_font(s_loc_layer, fonts_get_system_font(is_emery ? FONT_KEY_GOTHIC_24_BOLD : FONT_KEY_GOTHIC_18_BOLD));
-  text_layer_set_text_color(s_loc_layer, text_color);
-  text_layer_set_background_color(s_loc_layer, GColorClear);
-  layer_add_child(window_layer, text_layer_get_layer(s_loc_layer));
-
-  s_temp_arc_layer = layer_create(GRect(PADDING, widget_offset, arc_width, arc_width));
-  layer_set_update_proc(s_temp_arc_layer, temperature_update_proc);
-  layer_add_child(window_layer, s_temp_arc_layer);
-
-  s_temperature_layer = text_layer_create(GRect(PADDING, widget_offset + arc_width / 2 - (is_emery ? 22 : 18) + 5, arc_width, arc_width));
-  text_layer_set_text(s_temperature_layer, "--");
-  text_layer_set_text_alignment(s_temperature_layer, GTextAlignmentCenter);
-  text_layer_set_font(s_temperature_layer, fonts_get_system_font(is_emery ? FONT_KEY_GOTHIC_24_BOLD : FONT_KEY_GOTHIC_18_BOLD));
-  text_layer_set_text_color(s_temperature_layer, text_color);
-  text_layer_set_background_color(s_temperature_layer, GColorClear);
-  layer_add_child(window_layer, text_layer_get_layer(s_temperature_layer));
-
-  s_low_layer = text_layer_create(GRect(PADDING + arc_width / 2 - ((arc_width / 2) * 0.7), is_emery ? widget_offset + arc_width - 12 : widget_offset + arc_width - 9, is_emery ? 24 : 20, is_emery ? 18 : 15));
-  text_layer_set_text(s_low_layer, "--");
-  text_layer_set_text_alignment(s_low_layer, GTextAlignmentLeft);
-  text_layer_set_font(s_low_layer, fonts_get_system_font(is_emery ? FONT_KEY_GOTHIC_14_BOLD : FONT_KEY_GOTHIC_09));
-  text_layer_set_text_color(s_low_layer, accent_color);
-  text_layer_set_background_color(s_low_layer, GColorClear);
-  layer_add_child(window_layer, text_layer_get_layer(s_low_layer));
-
-  s_high_layer = text_layer_create(GRect(PADDING + arc_width - ((arc_width / 2) * 0.7) - 12, is_emery ? widget_offset + arc_width - 12 : widget_offset + arc_width - 9, is_emery ? 24 : 20, is_emery ? 18 : 15));
-  text_layer_set_text(s_high_layer, "--");
-  text_layer_set_text_alignment(s_high_layer, GTextAlignmentRight);
-  text_layer_set_font(s_high_layer, fonts_get_system_font(is_emery ? FONT_KEY_GOTHIC_14_BOLD : FONT_KEY_GOTHIC_09));
-  text_layer_set_text_color(s_high_layer, accent_color);
-  text_layer_set_background_color(s_high_layer, GColorClear);
-  layer_add_child(window_layer, text_layer_get_layer(s_high_layer));
-
-  s_health_layer = layer_create(GRect(PADDING * 2 + arc_width + 3, widget_offset, arc_width, arc_width));
-  layer_set_update_proc(s_health_layer, health_update_proc);
-  layer_add_child(window_layer, s_health_layer);
+    accel_tap_service_unsubscribe();
+  }
+}
 
-  s_check_path = gpath_create(&CHECK_PATH_INFO);
-  const int16_t checkmark_width = 18;
-  const int16_t checkmark_height = 15;
-  gpath_move_to(s_check_path, GPoint((arc_width - checkmark_width) / 2, (arc_width - checkmark_height) / 2));
+// Walks the message once. Message keys are SDK-generated variables rather
+// than constants, hence the if/else chain instead of a switch.
+static void inbox_recv_callback(DictionaryIterator *iterator, void *context)
+{
+  bool goals_changed = false;
+  bool health_changed = false;
+  bool perf_requested = false;
+  bool places_changed = false;
+  bool power_changed = false;
+  perf_inbox_received();
+
+  for (Tuple *tuple = dict_read_first(iterator); tuple; tuple = dict_read_next(iterator))
+  {
+    const uint32_t key = tuple->key;
+    if (key == MESSAGE_KEY_WEATHER)
+    {
+      WeatherPayload weather;
+      if (weather_payload_decode(tuple, &weather))
+      {
+        apply_weather(&weather);
+      }
+    }
+    else if (key == MESSAGE_KEY_FORECAST)
+    {
+      // The reply's own current reading is fresher; the forecast takes over
+      // from the next hour.
+      if (tuple->type == TUPLE_BYTE_ARRAY && forecast_store(tuple->value->data, tuple->length))
+      {
+        forecast_save(FORECAST_KEY);
+      }
+    }
+    else if (key == MESSAGE_KEY_PLACES)
+    {
+      if (tuple->type == TUPLE_BYTE_ARRAY && places_store(tuple->value->data, tuple->length))
+      {
+        places_save(PLACES_KEY);
+        places_changed = true;
+      }
+    }
+    else if (key == MESSAGE_KEY_PERF_DUMP)
+    {
+      perf_requested = true;
+    }
+    else if (key == MESSAGE_KEY_UPDATE_INTERVAL)
+    {
+      s_settings.weather_update_interval = tuple->value->int32;
+    }
+    else if (key == MESSAGE_KEY_BACKGROUND_COLOUR)
+    {
+      if (set_color(&s_settings.background_color, tuple))
+      {
+        ring_cache_invalidate();
+        text_color = gcolor_legible_over(s_settings.background_color);
+        views_set_background(s_settings.background_color);
+        view_set_text_color(VIEW_TIME, text_color);
+        view_set_text_color(VIEW_DATE, text_color);
+        view_set_text_color(VIEW_LOCATION, text_color);
+        view_set_text_color(VIEW_TEMPERATURE, text_color);
+      }
+    }
+    else if (key == MESSAGE_KEY_ACCENT_COLOUR)
+    {
+      if (set_color(&s_settings.accent_color, tuple))
+      {
+        ring_cache_invalidate();
+        view_set_text_color(VIEW_LOW, s_settings.accent_color);
+        view_set_text_color(VIEW_HIGH, s_settings.accent_color);
+        view_set_text_color(VIEW_DAY, s_settings.accent_color);
+        view_mark_dirty(VIEW_TEMPERATURE_ARC);
+        view_mark_dirty(VIEW_HEALTH);
+        view_mark_dirty(VIEW_BATTERY);
+      }
+    }
+    else if (key == MESSAGE_KEY_HEALTH_OUTER_ARC_COLOUR)
+    {
+      health_changed |= set_color(&s_settings.health_outer_arc_color, tuple);
+    }
+    else if (key == MESSAGE_KEY_HEALTH_MIDDLE_ARC_COLOUR)
+    {
+      health_changed |= set_color(&s_settings.health_middle_arc_color, tuple);
+    }
+    else if (key == MESSAGE_KEY_HEALTH_INNER_ARC_COLOUR)
+    {
+      health_changed |= set_color(&s_settings.health_inner_arc_color, tuple);
+    }
+    else if (key == MESSAGE_KEY_LOW_POWER_LEVEL)
+    {
+      power_changed |= set_uint8(&s_settings.low_power_level, tuple);
+    }
+    else if (key == MESSAGE_KEY_QUIET_START)
+    {
+      power_changed |= set_uint8(&s_settings.quiet_start, tuple);
+    }
+    else if (key == MESSAGE_KEY_QUIET_END)
+    {
+      power_changed |= set_uint8(&s_settings.quiet_end, tuple);
+    }
+    else if (key == MESSAGE_KEY_STEP_GOAL)
+    {
+      s_settings.step_goal = tuple->value->int32;
+      goals_changed = true;
+    }
+    else if (key == MESSAGE_KEY_MOVE_GOAL)
+    {
+      s_settings.move_goal = tuple->value->int32;
+      goals_changed = true;
+    }
+    else if (key == MESSAGE_KEY_CAL_GOAL)
+    {
+      s_settings.active_goal = tuple->value->int32;
+      goals_changed = true;
+    }
+  }
 
-  if (is_emery)
+  if (health_changed)
   {
-    s_bolt_path = gpath_create(&BOLT_LARGE_PATH_INFO);
-    gpath_move_to(s_bolt_path, GPoint(14, 12));
+    view_mark_dirty(VIEW_HEALTH);
   }
-  else
+
+  if (goals_changed)
+  {
+    mark_health_dirty_if_changed();
+  }
+
+  if (power_changed)
+  {
+    power_update_now();
+  }
+
+  if (places_changed)
+  {
+    accel_tap_update();
+  }
+  if (places_changed && s_place_shown)
   {
-    s_bolt_path = gpath_create(&BOLT_PATH_INFO);
-    gpath_move_to(s_bolt_path, GPoint(10, 8));
+    if (s_place_shown > places_count())
+    {
+      s_place_shown = 0;
+    }
+    show_place(time(NULL));
+  }
+
+  settings_save();
+  perf_heap_sample();
+
+  if (perf_requested)
+  {
+    send_perf();
   }
-  s_battery_layer = layer_create(GRect(bounds.size.w - PADDING - arc_width, widget_offset, arc_width, arc_width));
-  layer_set_update_proc(s_battery_layer, battery_update_proc);
-  layer_add_child(window_layer, s_battery_layer);
 }
 
-static void main_window_unload(Window *window)
+static void inbox_dropped_callback(AppMessageResult reason, void *context)
 {
-  bitmap_layer_destroy(s_condition_layer);
-  gbitmap_destroy(s_condition_bitmap);
-  layer_destroy(s_temp_arc_layer);
-  text_layer_destroy(s_temperature_layer);
-  text_layer_destroy(s_low_layer);
-  text_layer_destroy(s_high_layer);
-  layer_destroy(s_health_layer);
-  layer_destroy(s_battery_layer);
-  gpath_destroy(s_bolt_path);
-  text_layer_destroy(s_loc_layer);
-  text_layer_destroy(s_time_layer);
-  text_layer_destroy(s_day_layer);
-  text_layer_destroy(s_date_layer);
-  fonts_unload_custom_font(tomorrow_62);
-  fonts_unload_custom_font(tomorrow_45);
+  APP_LOG(APP_LOG_LEVEL_ERROR, "Message dropped!");
+  perf_inbox_dropped(reason);
+}
 
-  gpath_destroy(s_check_path);
+static void outbox_failed_callback(DictionaryIterator *iterator, AppMessageResult reason, void *context)
+{
+  APP_LOG(APP_LOG_LEVEL_ERROR, "Outbox send failed!");
+  perf_outbox_failed(reason);
+  outbox_failed(reason);
 }
 
-static void init(void)
+static void outbox_sent_callback(DictionaryIterator *iterator, void *context)
 {
-  s_window = window_create();
-  window_set_window_handlers(s_window, (WindowHandlers){
-                                           .load = main_window_load,
-                                           .unload = main_window_unload,
-                                       });
+  APP_LOG(APP_LOG_LEVEL_INFO, "Outbox send success!");
+  perf_outbox_sent();
+  outbox_sent();
+}
 
-  tomorrow_62 = fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_TOMORROW_62));
-  tomorrow_45 = fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_TOMORROW_45));
+static void update_time(struct tm *tick_time)
+{
+  static char time_buffer[] = "00:00";
 
-  if (persist_exists(MESSAGE_KEY_UPDATE_INTERVAL))
+  strftime(time_buffer, sizeof(time_buffer), clock_is_24h_style() ? "%H:%M" : "%I:%M", tick_time);
+  view_set_text(VIEW_TIME, time_buffer);
+
+  // Day and date only change at midnight.
+  const int day_stamp = tick_time->tm_year * 1000 + tick_time->tm_yday;
+  if (day_stamp == s_rendered.day_stamp)
   {
-    weather_update_interval = persist_read_int(MESSAGE_KEY_UPDATE_INTERVAL);
+    return;
   }
-  if (persist_exists(MESSAGE_KEY_BACKGROUND_COLOUR))
+  s_rendered.day_stamp = day_stamp;
+
+  static char day_buffer[] = "Mon";
+  strftime(day_buffer, sizeof(day_buffer), "%a", tick_time);
+  view_set_text(VIEW_DAY, day_buffer);
+
+  static char date_buffer[] = "01";
+  strftime(date_buffer, sizeof(date_buffer), "%d", tick_time);
+  view_set_text(VIEW_DATE, date_buffer);
+}
+
+// Movement updates only refresh the totals; the ring is redrawn with the
+// next minute tick so it shares the frame the time digits need anyway.
+// While saving power the totals are left alone until full mode resumes.
+static void health_handler(HealthEventType event, void *context)
+{
+  if (s_power.saving)
   {
-    background_color = GColorFromHEX(persist_read_int(MESSAGE_KEY_BACKGROUND_COLOUR));
-    text_color = gcolor_legible_over(background_color);
+    return;
   }
-  else
+  switch (event)
   {
-    background_color = GColorBlack;
-    text_color = GColorWhite;
+  case HealthEventSignificantUpdate:
+    update_health_metrics();
+    mark_health_dirty_if_changed();
+    step_history_rebuild(time(NULL));
+    view_mark_dirty(VIEW_STEP_HISTORY);
+    break;
+  case HealthEventMovementUpdate:
+    update_health_window();
+    break;
+  default:
+    break;
   }
-  if (persist_exists(MESSAGE_KEY_ACCENT_COLOUR))
+}
+
+static void app_connection_handler(bool connected)
+{
+  if (connected)
   {
-    accent_color = GColorFromHEX(persist_read_int(MESSAGE_KEY_ACCENT_COLOUR));
+    weather_reset_backoff();
+    schedule_weather();
   }
-  else
+}
+
+static void tick_handler(struct tm *tick_time, TimeUnits units_changed)
+{
+  if (units_changed & HOUR_UNIT)
   {
-    accent_color = GColorMediumAquamarine;
+    power_update(tick_time);
+    forecast_show(time(NULL));
+    if (s_place_shown)
+    {
+      show_place(time(NULL));
+    }
+  }
+  schedule_weather();
+  update_time(tick_time);
+  if (s_power.saving)
+  {
+    return;
   }
 
-  if (persist_exists(MESSAGE_KEY_HEALTH_OUTER_ARC_COLOUR))
+  // Health totals arrive through health_handler; the tick only has to reset
+  // them at midnight, or poll the short window where events are unavailable.
+  if (units_changed & DAY_UNIT)
   {
-    health_outer_arc_color = GColorFromHEX(persist_read_int(MESSAGE_KEY_HEALTH_OUTER_ARC_COLOUR));
+    update_health_metrics();
   }
-  else
+  else if (!s_health_events)
   {
-    health_outer_arc_color = accent_color;
+    update_health_window();
   }
+  mark_health_dirty_if_changed();
 
-  if (persist_exists(MESSAGE_KEY_HEALTH_MIDDLE_ARC_COLOUR))
+  if (step_history_sync(time(NULL)))
+  {
+    view_mark_dirty(VIEW_STEP_HISTORY);
+  }
+  if (units_changed & HOUR_UNIT)
   {
-    health_middle_arc_color = GColorFromHEX(persist_read_int(MESSAGE_KEY_HEALTH_MIDDLE_ARC_COLOUR));
+    step_history_save(STEP_HISTORY_KEY);
+  }
+}
+
+static GRect offset_rect(GRect rect, GPoint origin)
+{
+  return GRect(rect.origin.x + origin.x, rect.origin.y + origin.y, rect.size.w, rect.size.h);
+}
+
+static GPoint offset_point(GPoint point, GPoint origin)
+{
+  return GPoint(point.x + origin.x, point.y + origin.y);
+}
+
+// The widgets draw into frame, which is their layer's bounds in the layer
+// tree and their window position on the display list canvas.
+static void temperature_draw(GContext *ctx, GRect frame)
+{
+  const uint32_t start = perf_now_ms();
+  if (s_temperature_ring_cache)
+  {
+    ring_cache_draw(ctx, frame, s_temperature_ring_cache);
   }
   else
   {
-    health_middle_arc_color = accent_color;
+    graphics_context_set_stroke_width(ctx, 4);
+    graphics_context_set_fill_color(ctx, s_settings.accent_color);
+    graphics_fill_radial(ctx, offset_rect(ARC_RINGS[0], frame.origin), GOvalScaleModeFitCircle, ARC_RING_THICKNESS, 0, TRIG_MAX_ANGLE);
+    graphics_context_set_fill_color(ctx, s_settings.background_color);
+    graphics_fill_radial(ctx, GRect(frame.origin.x, frame.origin.y, ARC_WIDTH + 1, ARC_WIDTH + 1), GOvalScaleModeFitCircle, 7, DEG_TO_TRIGANGLE(127), DEG_TO_TRIGANGLE(233));
+    s_temperature_ring_cache = ring_cache_capture(s_view_frames[VIEW_TEMPERATURE_ARC], ctx);
   }
+  const GPoint marker = offset_point(arc_temperature_marker(s_rendered.temperature, s_rendered.low_temp, s_rendered.high_temp), frame.origin);
+  graphics_context_set_fill_color(ctx, s_settings.background_color);
+  graphics_fill_circle(ctx, marker, 4);
+  graphics_context_set_fill_color(ctx, text_color);
+  graphics_fill_circle(ctx, marker, 2);
+  perf_draw(PERF_DRAW_TEMPERATURE, start);
+}
 
-  if (persist_exists(MESSAGE_KEY_HEALTH_INNER_ARC_COLOUR))
+static void health_draw(GContext *ctx, GRect frame)
+{
+  const uint32_t start = perf_now_ms();
+  if (!s_rendered.goals_met)
   {
-    health_inner_arc_color = GColorFromHEX(persist_read_int(MESSAGE_KEY_HEALTH_INNER_ARC_COLOUR));
+    // Draw background circles
+    if (s_health_ring_cache)
+    {
+      ring_cache_draw(ctx, frame, s_health_ring_cache);
+    }
+    else
+    {
+      graphics_context_set_fill_color(ctx, GColorDarkGray);
+      for (size_t i = 0; i < ARRAY_LENGTH(ARC_RINGS); i++)
+      {
+        graphics_fill_radial(ctx, offset_rect(ARC_RINGS[i], frame.origin), GOvalScaleModeFitCircle, ARC_RING_THICKNESS, 0, TRIG_MAX_ANGLE);
+      }
+      s_health_ring_cache = ring_cache_capture(s_view_frames[VIEW_HEALTH], ctx);
+    }
+
+    // Draw progress arcs
+    graphics_context_set_fill_color(ctx, s_settings.health_outer_arc_color);
+    graphics_fill_radial(ctx, offset_rect(ARC_RINGS[0], frame.origin), GOvalScaleModeFitCircle, ARC_RING_THICKNESS, 0, arc_steps_to_angle(s_rendered.step_arc));
+
+    graphics_context_set_fill_color(ctx, s_settings.health_middle_arc_color);
+    graphics_fill_radial(ctx, offset_rect(ARC_RINGS[1], frame.origin), GOvalScaleModeFitCircle, ARC_RING_THICKNESS, 0, arc_steps_to_angle(s_rendered.move_arc));
+
+    graphics_context_set_fill_color(ctx, s_settings.health_inner_arc_color);
+    graphics_fill_radial(ctx, offset_rect(ARC_RINGS[2], frame.origin), GOvalScaleModeFitCircle, ARC_RING_THICKNESS, 0, arc_steps_to_angle(s_rendered.active_arc));
   }
   else
   {
-    health_inner_arc_color = accent_color;
+    // Draw checkmark
+    graphics_context_set_fill_color(ctx, s_settings.accent_color);
+    graphics_fill_radial(ctx, offset_rect(ARC_RINGS[0], frame.origin), GOvalScaleModeFitCircle, ARC_RING_THICKNESS, 0, TRIG_MAX_ANGLE);
+    gpath_move_to(s_check_path, offset_point(CHECK_ORIGIN, frame.origin));
+    gpath_draw_filled(ctx, s_check_path);
   }
-  if (persist_exists(MESSAGE_KEY_STEP_GOAL))
+  perf_draw(PERF_DRAW_HEALTH, start);
+}
+
+// Steps per hour up to the current one, oldest on the left, scaled to the
+// busiest hour shown.
+static void step_history_draw(GContext *ctx, GRect frame)
+{
+  const time_t now = time(NULL);
+  const time_t oldest = now - now % (60 * 60) - (STEP_HISTORY_HOURS - 1) * 60 * 60;
+  uint16_t steps[STEP_HISTORY_HOURS];
+  uint16_t busiest = 0;
+  for (int i = 0; i < STEP_HISTORY_HOURS; i++)
   {
-    step_goal = persist_read_int(MESSAGE_KEY_STEP_GOAL);
+    steps[i] = step_history_get(oldest + i * 60 * 60);
+    busiest = steps[i] > busiest ? steps[i] : busiest;
   }
-  if (persist_exists(MESSAGE_KEY_MOVE_GOAL))
+  if (!busiest)
   {
-    move_goal = persist_read_int(MESSAGE_KEY_MOVE_GOAL);
+    return;
   }
-  if (persist_exists(MESSAGE_KEY_CAL_GOAL))
+  graphics_context_set_fill_color(ctx, s_settings.health_outer_arc_color);
+  for (int i = 0; i < STEP_HISTORY_HOURS; i++)
   {
-    active_goal = persist_read_int(MESSAGE_KEY_CAL_GOAL);
+    // Rounded up so every hour with steps shows.
+    const int16_t height = (steps[i] * frame.size.h + busiest - 1) / busiest;
+    const int16_t x = frame.origin.x + i * frame.size.w / STEP_HISTORY_HOURS;
+    const int16_t width = frame.origin.x + (i + 1) * frame.size.w / STEP_HISTORY_HOURS - x;
+    if (height && width)
+    {
+      graphics_fill_rect(ctx, GRect(x, frame.origin.y + frame.size.h - height, width, height), 0, GCornerNone);
+    }
   }
-  if (persist_exists(MESSAGE_KEY_CONDITIONS))
+}
+
+static void battery_draw(GContext *ctx, GRect frame)
+{
+  const uint32_t start = perf_now_ms();
+  if (battery_level > 20)
   {
-    weather_index = persist_read_int(MESSAGE_KEY_CONDITIONS);
+    graphics_context_set_fill_color(ctx, s_settings.accent_color);
   }
-  if (persist_exists(MESSAGE_KEY_LOCATION_NAME))
+  else
   {
-    persist_read_string(MESSAGE_KEY_LOCATION_NAME, location, sizeof(location));
+    graphics_context_set_fill_color(ctx, GColorSunsetOrange);
   }
-  if (persist_exists(MESSAGE_KEY_CUR_TEMP))
+  const int32_t angle = arc_steps_to_angle(arc_steps(100 - battery_level, 100));
+  graphics_fill_radial(ctx, offset_rect(ARC_RINGS[0], frame.origin), GOvalScaleModeFitCircle, ARC_RING_THICKNESS, angle, TRIG_MAX_ANGLE);
+  gpath_move_to(s_bolt_path, offset_point(LAYOUT.bolt_origin, frame.origin));
+  gpath_draw_filled(ctx, s_bolt_path);
+  perf_draw(PERF_DRAW_BATTERY, start);
+}
+
+static void temperature_update_proc(Layer *layer, GContext *ctx)
+{
+  temperature_draw(ctx, layer_get_bounds(layer));
+}
+
+static void health_update_proc(Layer *layer, GContext *ctx)
+{
+  health_draw(ctx, layer_get_bounds(layer));
+}
+
+static void step_history_update_proc(Layer *layer, GContext *ctx)
+{
+  step_history_draw(ctx, layer_get_bounds(layer));
+}
+
+static void battery_update_proc(Layer *layer, GContext *ctx)
+{
+  battery_draw(ctx, layer_get_bounds(layer));
+}
+
+static void battery_callback(BatteryChargeState state)
+{
+  const bool charging = state.is_charging || state.is_plugged;
+  if (state.charge_percent == battery_level && charging == s_power.charging)
   {
-    temperature = persist_read_int(MESSAGE_KEY_CUR_TEMP);
+    return;
   }
-  if (persist_exists(MESSAGE_KEY_LOW_TEMP))
+  if (state.charge_percent != battery_level)
   {
-    low_temp = persist_read_int(MESSAGE_KEY_LOW_TEMP);
+    battery_level = state.charge_percent;
+    view_mark_dirty(VIEW_BATTERY);
   }
-  if (persist_exists(MESSAGE_KEY_HIGH_TEMP))
+  s_power.charging = charging;
+  power_update_now();
+}
+
+static void view_create_text(Layer *parent, ViewId view, GRect frame, GFont font, GTextAlignment alignment, GTextOverflowMode overflow, GColor color, const char *text)
+{
+  s_view_frames[view] = frame;
+#if defined(MODULUS_DISPLAY_LIST)
+  s_views[view] = (DisplayItem){
+      .kind = DisplayItemText,
+      .frame = frame,
+      .color = color,
+      .alignment = alignment,
+      .overflow = overflow,
+      .font = font,
+      .text = text,
+  };
+#else
+  TextLayer *text_layer = text_layer_create(frame);
+  text_layer_set_text(text_layer, text);
+  text_layer_set_text_alignment(text_layer, alignment);
+  text_layer_set_overflow_mode(text_layer, overflow);
+  text_layer_set_font(text_layer, font);
+  text_layer_set_text_color(text_layer, color);
+  text_layer_set_background_color(text_layer, GColorClear);
+  layer_add_child(parent, text_layer_get_layer(text_layer));
+  s_views[view].kind = DisplayItemText;
+  s_views[view].text = text_layer;
+#endif
+}
+
+static void view_create_bitmap(Layer *parent, ViewId view, GRect frame, const GBitmap *bitmap)
+{
+  s_view_frames[view] = frame;
+#if defined(MODULUS_DISPLAY_LIST)
+  s_views[view] = (DisplayItem){
+      .kind = DisplayItemBitmap,
+      .frame = frame,
+      .bitmap = bitmap,
+  };
+#else
+  BitmapLayer *bitmap_layer = bitmap_layer_create(frame);
+  bitmap_layer_set_bitmap(bitmap_layer, bitmap);
+  bitmap_layer_set_alignment(bitmap_layer, GAlignCenter);
+  bitmap_layer_set_compositing_mode(bitmap_layer, GCompOpSet);
+  layer_add_child(parent, bitmap_layer_get_layer(bitmap_layer));
+  s_views[view].kind = DisplayItemBitmap;
+  s_views[view].bitmap = bitmap_layer;
+#endif
+}
+
+// Custom views take both forms of their drawing code; each build uses one.
+static void view_create_custom(Layer *parent, ViewId view, GRect frame, DisplayItemDrawProc draw, LayerUpdateProc update_proc)
+{
+  s_view_frames[view] = frame;
+#if defined(MODULUS_DISPLAY_LIST)
+  s_views[view] = (DisplayItem){
+      .kind = DisplayItemCustom,
+      .frame = frame,
+      .draw = draw,
+  };
+#else
+  Layer *layer = layer_create(frame);
+  layer_set_update_proc(layer, update_proc);
+  layer_add_child(parent, layer);
+  s_views[view].kind = DisplayItemCustom;
+  s_views[view].custom = layer;
+#endif
+}
+
+static void views_destroy()
+{
+#if defined(MODULUS_DISPLAY_LIST)
+  display_list_destroy();
+#else
+  for (int i = 0; i < VIEW_COUNT; i++)
   {
-    high_temp = persist_read_int(MESSAGE_KEY_HIGH_TEMP);
+    switch (s_views[i].kind)
+    {
+    case DisplayItemText:
+      text_layer_destroy(s_views[i].text);
+      break;
+    case DisplayItemBitmap:
+      bitmap_layer_destroy(s_views[i].bitmap);
+      break;
+    case DisplayItemCustom:
+      layer_destroy(s_views[i].custom);
+      break;
+    }
   }
+#endif
+}
+
+// Where every view goes in a window of the given size. The arcs and the
+// location line hang off the bottom edge, so they follow the unobstructed
+// area up when Timeline Quick View covers part of the screen; the location
+// line is dropped when that would push it into the time.
+typedef struct
+{
+  GRect frames[VIEW_COUNT];
+  bool location_shown;
+} Layout;
+
+static void layout_compute(GRect bounds, Layout *layout)
+{
+  const int16_t widget_offset = bounds.size.h - ARC_WIDTH - 10;
+  const int16_t range_top = widget_offset + ARC_WIDTH - LAYOUT.range_rise;
+  const GSize range = LAYOUT.range_size;
+  GRect *frames = layout->frames;
+
+  frames[VIEW_TIME] = GRect(0, LAYOUT.time_top, bounds.size.w - PADDING, LAYOUT.time_height);
+  frames[VIEW_DAY] = GRect(bounds.size.w - 70 - PADDING, LAYOUT.label_top, 50, LAYOUT.label_height);
+  frames[VIEW_DATE] = GRect(PADDING, LAYOUT.label_top, bounds.size.w - PADDING * 2, LAYOUT.label_height);
+  frames[VIEW_CONDITION] = GRect(PADDING + 5, widget_offset - LAYOUT.condition_rise, 21, 21);
+  frames[VIEW_LOCATION] = GRect(PADDING + 30, widget_offset - LAYOUT.location_rise, bounds.size.w - PADDING - 30, LAYOUT.label_height);
+  frames[VIEW_TEMPERATURE_ARC] = GRect(PADDING, widget_offset, ARC_WIDTH, ARC_WIDTH);
+  frames[VIEW_TEMPERATURE] = GRect(PADDING, widget_offset + ARC_WIDTH / 2 - LAYOUT.temperature_rise, ARC_WIDTH, ARC_WIDTH);
+  frames[VIEW_LOW] = GRect(PADDING + ARC_WIDTH / 2 - ((ARC_WIDTH / 2) * 7 / 10), range_top, range.w, range.h);
+  frames[VIEW_HIGH] = GRect(PADDING + ARC_WIDTH - ((ARC_WIDTH / 2) * 7 / 10) - 12, range_top, range.w, range.h);
+  frames[VIEW_HEALTH] = GRect(PADDING * 2 + ARC_WIDTH + 3, widget_offset, ARC_WIDTH, ARC_WIDTH);
+  frames[VIEW_STEP_HISTORY] = GRect(PADDING * 2 + ARC_WIDTH + 3, widget_offset + ARC_WIDTH + 1, ARC_WIDTH, 8);
+  frames[VIEW_BATTERY] = GRect(bounds.size.w - PADDING - ARC_WIDTH, widget_offset, ARC_WIDTH, ARC_WIDTH);
+
+  const GRect time = frames[VIEW_TIME];
+  layout->location_shown = frames[VIEW_LOCATION].origin.y >= time.origin.y + time.size.h;
+}
+
+static void view_set_frame(ViewId view, GRect frame)
+{
+  s_view_frames[view] = frame;
+#if defined(MODULUS_DISPLAY_LIST)
+  // A moved item leaves its old pixels behind.
+  s_views[view].frame = frame;
+  display_list_invalidate();
+#else
+  layer_set_frame(view_layer(view), frame);
+#endif
+}
+
+// Moves only the views whose frame changed; nothing is recreated, so this
+// runs on every frame of the Quick View animation.
+static void layout_apply(GRect bounds)
+{
+  Layout layout;
+  layout_compute(bounds, &layout);
+  for (int i = 0; i < VIEW_COUNT; i++)
+  {
+    if (!grect_equal(&layout.frames[i], &s_view_frames[i]))
+    {
+      view_set_frame(i, layout.frames[i]);
+    }
+  }
+  view_set_hidden(VIEW_CONDITION, !layout.location_shown);
+  view_set_hidden(VIEW_LOCATION, !layout.location_shown);
+}
+
+static void unobstructed_change(AnimationProgress progress, void *context)
+{
+  layout_apply(layer_get_unobstructed_bounds(window_get_root_layer(s_window)));
+}
+
+static void main_window_load(Window *window)
+{
+  Layer *window_layer = window_get_root_layer(window);
+  Layout layout;
+  layout_compute(layer_get_unobstructed_bounds(window_layer), &layout);
+  const GRect *frames = layout.frames;
+
+  const GFont label_font = fonts_get_system_font(LAYOUT.label_font);
+  const GFont range_font = fonts_get_system_font(LAYOUT.range_font);
+  s_time_font = fonts_load_custom_font(resource_get_handle(LAYOUT.time_font));
+  weather_icons_load();
+  s_check_path = gpath_create(&CHECK_PATH_INFO);
+  s_bolt_path = gpath_create(&LAYOUT_BOLT);
+
+#if defined(MODULUS_DISPLAY_LIST)
+  layer_add_child(window_layer, display_list_create(layer_get_bounds(window_layer), s_views, VIEW_COUNT));
+#endif
+
+  view_create_text(window_layer, VIEW_TIME, frames[VIEW_TIME],
+                   s_time_font, GTextAlignmentRight, GTextOverflowModeWordWrap, text_color, "24");
+  view_create_text(window_layer, VIEW_DAY, frames[VIEW_DAY],
+                   label_font, GTextAlignmentRight, GTextOverflowModeWordWrap, s_settings.accent_color, "");
+  view_create_text(window_layer, VIEW_DATE, frames[VIEW_DATE],
+                   label_font, GTextAlignmentRight, GTextOverflowModeWordWrap, text_color, "");
+  view_create_bitmap(window_layer, VIEW_CONDITION, frames[VIEW_CONDITION],
+                     s_weather_icons[weather_icon_index(s_rendered.weather_index)]);
+  view_create_text(window_layer, VIEW_LOCATION, frames[VIEW_LOCATION],
+                   label_font, GTextAlignmentLeft, GTextOverflowModeTrailingEllipsis, text_color, s_settings.location);
+
+  view_create_custom(window_layer, VIEW_TEMPERATURE_ARC, frames[VIEW_TEMPERATURE_ARC],
+                     temperature_draw, temperature_update_proc);
+  view_create_text(window_layer, VIEW_TEMPERATURE, frames[VIEW_TEMPERATURE],
+                   label_font, GTextAlignmentCenter, GTextOverflowModeWordWrap, text_color, "--");
+  view_create_text(window_layer, VIEW_LOW, frames[VIEW_LOW],
+                   range_font, GTextAlignmentLeft, GTextOverflowModeWordWrap, s_settings.accent_color, "--");
+  view_create_text(window_layer, VIEW_HIGH, frames[VIEW_HIGH],
+                   range_font, GTextAlignmentRight, GTextOverflowModeWordWrap, s_settings.accent_color, "--");
+
+  view_create_custom(window_layer, VIEW_HEALTH, frames[VIEW_HEALTH],
+                     health_draw, health_update_proc);
+  view_create_custom(window_layer, VIEW_STEP_HISTORY, frames[VIEW_STEP_HISTORY],
+                     step_history_draw, step_history_update_proc);
+  view_create_custom(window_layer, VIEW_BATTERY, frames[VIEW_BATTERY],
+                     battery_draw, battery_update_proc);
+  view_set_hidden(VIEW_CONDITION, !layout.location_shown);
+  view_set_hidden(VIEW_LOCATION, !layout.location_shown);
+
+  unobstructed_area_service_subscribe((UnobstructedAreaHandlers){
+                                          .change = unobstructed_change,
+                                      },
+                                      NULL);
+
+  perf_heap_sample();
+}
+
+#if defined(MODULUS_DISPLAY_LIST)
+// Whatever covered the window may have drawn over the retained frame.
+static void main_window_appear(Window *window)
+{
+  display_list_invalidate();
+}
+#endif
+
+static void main_window_unload(Window *window)
+{
+  unobstructed_area_service_unsubscribe();
+  step_history_save(STEP_HISTORY_KEY);
+  views_destroy();
+  weather_icons_unload();
+  gpath_destroy(s_bolt_path);
+  gpath_destroy(s_check_path);
+  fonts_unload_custom_font(s_time_font);
+  ring_cache_invalidate();
+}
+
+static void init(void)
+{
+  perf_init();
+  s_window = window_create();
+  window_set_window_handlers(s_window, (WindowHandlers){
+                                           .load = main_window_load,
+#if defined(MODULUS_DISPLAY_LIST)
+                                           .appear = main_window_appear,
+#endif
+                                           .unload = main_window_unload,
+                                       });
+
+  settings_load();
+  text_color = gcolor_legible_over(s_settings.background_color);
+  s_rendered.temperature = s_settings.temperature;
+  s_rendered.low_temp = s_settings.low_temp;
+  s_rendered.high_temp = s_settings.high_temp;
+  s_rendered.weather_index = s_settings.weather_index;
 
   const bool animated = true;
   window_stack_push(s_window, animated);
-  window_set_background_color(s_window, background_color);
+  views_set_background(s_settings.background_color);
 
   app_message_register_inbox_received(inbox_recv_callback);
   app_message_register_inbox_dropped(inbox_dropped_callback);
@@ -578,15 +1665,43 @@ static void init(void)
   const int outbox_size = 128;
   app_message_open(inbox_size, outbox_size);
 
-  update_time();
+  time_t now = time(NULL);
+  update_time(localtime(&now));
+  forecast_load(FORECAST_KEY);
+  // A reply from this hour is at least as recent as its forecast hour.
+  if ((time_t)s_settings.weather_updated / (60 * 60) < now / (60 * 60))
+  {
+    forecast_show(now);
+  }
+  places_load(PLACES_KEY);
+  accel_tap_update();
   tick_timer_service_subscribe(MINUTE_UNIT, tick_handler);
+  srand(now);
+  connection_service_subscribe((ConnectionHandlers){
+      .pebble_app_connection_handler = app_connection_handler,
+  });
   battery_state_service_subscribe(battery_callback);
-  battery_level = battery_state_service_peek().charge_percent;
+  const BatteryChargeState battery = battery_state_service_peek();
+  battery_level = battery.charge_percent;
+  s_power.charging = battery.is_charging || battery.is_plugged;
   update_health_metrics();
+  mark_health_dirty_if_changed();
+  if (!step_history_load(STEP_HISTORY_KEY))
+  {
+    step_history_rebuild(now);
+  }
+  power_update(localtime(&now));
+  s_health_events = health_service_events_subscribe(health_handler, NULL);
 }
 
 static void deinit(void)
 {
+  if (s_tap_subscribed)
+  {
+    accel_tap_service_unsubscribe();
+    s_tap_subscribed = false;
+  }
+  outbox_deinit();
   window_destroy(s_window);
 }
 
@@ -0,0 +1,136 @@
+#include "outbox.h"
+#include "perf.h"
+
+typedef struct
+{
+  OutboxWriter write;
+  OutboxDone done;
+  uint8_t attempts;
+  // Position in the queue, oldest first; 0 while the slot is empty.
+  uint32_t order;
+} OutboxEntry;
+
+static OutboxEntry s_waiting[OUTBOX_MAX_KINDS];
+// The message on the wire is moved out of its slot, so the same kind can
+// be queued again behind it.
+static OutboxEntry s_sending;
+static int s_sending_kind = -1;
+static uint32_t s_next_order = 1;
+static AppTimer *s_retry_timer;
+
+static void pump();
+
+static void retry_timer_callback(void *data)
+{
+  s_retry_timer = NULL;
+  pump();
+}
+
+static void send_failed(AppMessageResult reason)
+{
+  const int kind = s_sending_kind;
+  const OutboxEntry entry = s_sending;
+  s_sending_kind = -1;
+  if (entry.attempts >= OUTBOX_MAX_ATTEMPTS)
+  {
+    if (entry.done)
+    {
+      entry.done(reason);
+    }
+    pump();
+    return;
+  }
+  // A newer message of the same kind goes out in its place; otherwise this
+  // one goes back to the front of the queue.
+  OutboxEntry *waiting = &s_waiting[kind];
+  if (waiting->order)
+  {
+    waiting->attempts = entry.attempts;
+  }
+  else
+  {
+    *waiting = entry;
+  }
+  s_retry_timer = app_timer_register(OUTBOX_RETRY_BASE_MS << (entry.attempts - 1), retry_timer_callback, NULL);
+}
+
+static void pump()
+{
+  if (s_sending_kind >= 0 || s_retry_timer)
+  {
+    return;
+  }
+  int kind = -1;
+  for (int i = 0; i < OUTBOX_MAX_KINDS; i++)
+  {
+    if (s_waiting[i].order && (kind < 0 || s_waiting[i].order < s_waiting[kind].order))
+    {
+      kind = i;
+    }
+  }
+  if (kind < 0)
+  {
+    return;
+  }
+  s_sending = s_waiting[kind];
+  s_sending.attempts++;
+  s_sending_kind = kind;
+  s_waiting[kind].order = 0;
+
+  DictionaryIterator *iter;
+  AppMessageResult result = app_message_outbox_begin(&iter);
+  if (result == APP_MSG_OK)
+  {
+    s_sending.write(iter);
+    result = app_message_outbox_send();
+  }
+  if (result != APP_MSG_OK)
+  {
+    perf_outbox_failed(result);
+    send_failed(result);
+  }
+}
+
+void outbox_queue(uint8_t kind, OutboxWriter write, OutboxDone done)
+{
+  OutboxEntry *entry = &s_waiting[kind];
+  if (!entry->order)
+  {
+    entry->order = s_next_order++;
+    entry->attempts = 0;
+  }
+  entry->write = write;
+  entry->done = done;
+  pump();
+}
+
+void outbox_sent(void)
+{
+  if (s_sending_kind < 0)
+  {
+    return;
+  }
+  s_sending_kind = -1;
+  if (s_sending.done)
+  {
+    s_sending.done(APP_MSG_OK);
+  }
+  pump();
+}
+
+void outbox_failed(AppMessageResult reason)
+{
+  if (s_sending_kind >= 0)
+  {
+    send_failed(reason);
+  }
+}
+
+void outbox_deinit(void)
+{
+  if (s_retry_timer)
+  {
+    app_timer_cancel(s_retry_timer);
+    s_retry_timer = NULL;
+  }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <pebble.h>
+
+// Outgoing AppMessages queue here instead of going straight to
+// app_message_outbox_begin(), so one sent while another is in flight waits
+// rather than failing with APP_MSG_BUSY. Each kind of message has a single
+// slot: queueing a kind that is still waiting just takes the place of the
+// older one. The dictionary is written when the message actually goes out,
+// so a message that waited or is retried carries current data.
+//
+// A send that the phone NACKs, that times out or that cannot start is
+// retried with exponential backoff from OUTBOX_RETRY_BASE_MS, up to
+// OUTBOX_MAX_ATTEMPTS attempts in all.
+
+#define OUTBOX_MAX_KINDS 4
+#define OUTBOX_MAX_ATTEMPTS 4
+#define OUTBOX_RETRY_BASE_MS 1000
+
+typedef void (*OutboxWriter)(DictionaryIterator *iter);
+// APP_MSG_OK once the phone acknowledged the message, or the last error
+// once it is given up on. Not called for a message that was replaced.
+typedef void (*OutboxDone)(AppMessageResult result);
+
+// kind is the caller's own, below OUTBOX_MAX_KINDS; done may be NULL.
+void outbox_queue(uint8_t kind, OutboxWriter write, OutboxDone done);
+
+// To be called from the AppMessage outbox sent and failed handlers.
+void outbox_sent(void);
+void outbox_failed(AppMessageResult reason);
+
+// Cancels a pending retry, for when the app exits.
+void outbox_deinit(void);
@@ -0,0 +1,205 @@
+#include "perf.h"
+
+typedef struct
+{
+  time_t at;
+  uint8_t kind;
+  uint8_t detail;
+  uint16_t value;
+} PerfEvent;
+
+static struct
+{
+  time_t started;
+  uint16_t inbox_received;
+  uint16_t inbox_dropped;
+  uint16_t outbox_sent;
+  uint16_t outbox_failed;
+  uint16_t weather_replies;
+  uint16_t weather_latency_max;
+  uint32_t weather_latency_total;
+  uint16_t weather_timeouts;
+  uint16_t draw_max[PERF_DRAW_COUNT];
+  uint32_t heap_free_min;
+  bool weather_pending;
+  uint32_t weather_requested_ms;
+} s_perf;
+
+static PerfEvent s_events[PERF_EVENT_COUNT];
+static uint8_t s_event_next;
+static uint8_t s_event_count;
+
+static uint16_t saturate_u16(uint32_t value)
+{
+  return value > UINT16_MAX ? UINT16_MAX : value;
+}
+
+static void count(uint16_t *counter)
+{
+  if (*counter < UINT16_MAX)
+  {
+    (*counter)++;
+  }
+}
+
+static void record(PerfEventKind kind, uint8_t detail, uint32_t value)
+{
+  s_events[s_event_next] = (PerfEvent){
+      .at = time(NULL),
+      .kind = kind,
+      .detail = detail,
+      .value = saturate_u16(value),
+  };
+  s_event_next = (s_event_next + 1) % PERF_EVENT_COUNT;
+  if (s_event_count < PERF_EVENT_COUNT)
+  {
+    s_event_count++;
+  }
+}
+
+void perf_init(void)
+{
+  memset(&s_perf, 0, sizeof(s_perf));
+  s_perf.started = time(NULL);
+  s_perf.heap_free_min = UINT32_MAX;
+  s_event_next = 0;
+  s_event_count = 0;
+}
+
+uint32_t perf_now_ms(void)
+{
+  time_t seconds;
+  uint16_t ms;
+  time_ms(&seconds, &ms);
+  return (uint32_t)(seconds - s_perf.started) * 1000 + ms;
+}
+
+static uint32_t elapsed_ms(uint32_t start_ms)
+{
+  const uint32_t now = perf_now_ms();
+  return now > start_ms ? now - start_ms : 0;
+}
+
+void perf_draw(PerfDraw draw, uint32_t start_ms)
+{
+  const uint16_t elapsed = saturate_u16(elapsed_ms(start_ms));
+  if (elapsed > s_perf.draw_max[draw])
+  {
+    s_perf.draw_max[draw] = elapsed;
+    record(PerfEventSlowDraw, draw, elapsed);
+  }
+}
+
+void perf_inbox_received(void)
+{
+  count(&s_perf.inbox_received);
+}
+
+void perf_inbox_dropped(AppMessageResult reason)
+{
+  count(&s_perf.inbox_dropped);
+  record(PerfEventInboxDropped, 0, reason);
+}
+
+void perf_outbox_sent(void)
+{
+  count(&s_perf.outbox_sent);
+}
+
+void perf_outbox_failed(AppMessageResult reason)
+{
+  count(&s_perf.outbox_failed);
+  record(PerfEventOutboxFailed, 0, reason);
+}
+
+void perf_weather_requested(void)
+{
+  s_perf.weather_pending = true;
+  s_perf.weather_requested_ms = perf_now_ms();
+}
+
+// Replies the phone pushes on its own (start-up, settings) have no request
+// to measure against.
+void perf_weather_replied(void)
+{
+  if (!s_perf.weather_pending)
+  {
+    return;
+  }
+  s_perf.weather_pending = false;
+  const uint32_t latency = elapsed_ms(s_perf.weather_requested_ms);
+  count(&s_perf.weather_replies);
+  s_perf.weather_latency_total += latency;
+  if (latency > s_perf.weather_latency_max)
+  {
+    s_perf.weather_latency_max = saturate_u16(latency);
+  }
+  record(PerfEventWeatherLatency, 0, latency);
+}
+
+void perf_weather_timed_out(void)
+{
+  s_perf.weather_pending = false;
+  count(&s_perf.weather_timeouts);
+  record(PerfEventWeatherTimeout, 0, 0);
+}
+
+void perf_heap_sample(void)
+{
+  const uint32_t free_bytes = heap_bytes_free();
+  if (free_bytes < s_perf.heap_free_min)
+  {
+    s_perf.heap_free_min = free_bytes;
+    record(PerfEventHeapLow, 0, free_bytes);
+  }
+}
+
+static uint8_t *put_u16(uint8_t *out, uint16_t value)
+{
+  out[0] = value & 0xff;
+  out[1] = value >> 8;
+  return out + 2;
+}
+
+static uint8_t *put_u32(uint8_t *out, uint32_t value)
+{
+  out = put_u16(out, value & 0xffff);
+  return put_u16(out, value >> 16);
+}
+
+size_t perf_pack(uint8_t *buffer, size_t size)
+{
+  if (size < PERF_PAYLOAD_SIZE)
+  {
+    return 0;
+  }
+  const time_t now = time(NULL);
+  uint8_t *out = buffer;
+  *out++ = PERF_PAYLOAD_VERSION;
+  out = put_u32(out, now - s_perf.started);
+  out = put_u16(out, s_perf.inbox_received);
+  out = put_u16(out, s_perf.inbox_dropped);
+  out = put_u16(out, s_perf.outbox_sent);
+  out = put_u16(out, s_perf.outbox_failed);
+  out = put_u16(out, s_perf.weather_replies);
+  out = put_u16(out, s_perf.weather_latency_max);
+  out = put_u32(out, s_perf.weather_latency_total);
+  out = put_u16(out, s_perf.weather_timeouts);
+  for (int i = 0; i < PERF_DRAW_COUNT; i++)
+  {
+    out = put_u16(out, s_perf.draw_max[i]);
+  }
+  out = put_u32(out, s_perf.heap_free_min == UINT32_MAX ? 0 : s_perf.heap_free_min);
+  *out++ = s_event_count;
+
+  const uint8_t oldest = (s_event_next + PERF_EVENT_COUNT - s_event_count) % PERF_EVENT_COUNT;
+  for (uint8_t i = 0; i < s_event_count; i++)
+  {
+    const PerfEvent *event = &s_events[(oldest + i) % PERF_EVENT_COUNT];
+    *out++ = event->kind;
+    *out++ = event->detail;
+    out = put_u16(out, event->value);
+    out = put_u16(out, saturate_u16(now - event->at));
+  }
+  return out - buffer;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <pebble.h>
+
+// Field telemetry: counters and a small ring of notable events, all in
+// static storage. The phone asks for a copy with the PERF_DUMP message key
+// and gets perf_pack()'s bytes back under PERF; src/pkjs/perf.js decodes
+// them. Everything resets when the watchface starts.
+
+#define PERF_PAYLOAD_VERSION 1
+#define PERF_EVENT_COUNT 12
+#define PERF_PAYLOAD_HEADER_SIZE 34
+#define PERF_PAYLOAD_EVENT_SIZE 6
+#define PERF_PAYLOAD_SIZE (PERF_PAYLOAD_HEADER_SIZE + PERF_EVENT_COUNT * PERF_PAYLOAD_EVENT_SIZE)
+
+typedef enum
+{
+  PERF_DRAW_TEMPERATURE,
+  PERF_DRAW_HEALTH,
+  PERF_DRAW_BATTERY,
+  PERF_DRAW_COUNT,
+} PerfDraw;
+
+// Only these make it into the ring; plain successes are just counted.
+typedef enum
+{
+  PerfEventInboxDropped = 1,   // value: AppMessageResult
+  PerfEventOutboxFailed = 2,   // value: AppMessageResult
+  PerfEventWeatherLatency = 3, // value: ms from request to reply
+  PerfEventSlowDraw = 4,       // detail: PerfDraw, value: ms, a new maximum
+  PerfEventHeapLow = 5,        // value: free bytes, a new minimum
+  PerfEventWeatherTimeout = 6, // a request the phone never answered
+} PerfEventKind;
+
+void perf_init(void);
+
+// Milliseconds since perf_init(), from time_ms().
+uint32_t perf_now_ms(void);
+
+void perf_draw(PerfDraw draw, uint32_t start_ms);
+void perf_inbox_received(void);
+void perf_inbox_dropped(AppMessageResult reason);
+void perf_outbox_sent(void);
+void perf_outbox_failed(AppMessageResult reason);
+void perf_weather_requested(void);
+void perf_weather_replied(void);
+void perf_weather_timed_out(void);
+void perf_heap_sample(void);
+
+// Writes the payload into buffer and returns its length, or 0 if size is
+// smaller than PERF_PAYLOAD_SIZE. Layout, integers little endian:
+//   [0]      PERF_PAYLOAD_VERSION
+//   [1..4]   seconds since start
+//   [5..14]  inbox received, inbox dropped, outbox sent, outbox failed and
+//            weather replies, uint16 each
+//   [15..16] slowest weather reply, ms
+//   [17..20] total weather reply latency, ms
+//   [21..22] weather requests that timed out
+//   [23..28] slowest temperature, health and battery draw, ms, uint16 each
+//   [29..32] lowest heap_bytes_free() seen
+//   [33]     number of events N, then N events oldest first:
+//            kind, detail, uint16 value, uint16 seconds before the dump
+size_t perf_pack(uint8_t *buffer, size_t size);
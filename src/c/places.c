@@ -0,0 +1,126 @@
+#include "places.h"
+
+#define SECONDS_PER_HOUR 3600
+#define PLACE_ENTRY_HEADER_SIZE 13
+
+typedef struct __attribute__((__packed__))
+{
+  uint32_t updated;
+  PlaceWeather weather;
+  uint32_t forecast_start;
+  uint8_t forecast_count;
+  ForecastHour hours[PLACE_FORECAST_HOURS];
+  char name[PLACE_NAME_SIZE];
+} Place;
+
+typedef struct __attribute__((__packed__))
+{
+  uint8_t version;
+  uint8_t count;
+  Place places[PLACES_MAX];
+} Places;
+
+static Places s_places;
+
+static uint32_t read_uint32_le(const uint8_t *data)
+{
+  return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+// Decodes one entry into place and returns its size, or 0 if it does not
+// fit in the length bytes left.
+static size_t place_decode(const uint8_t *data, size_t length, Place *place)
+{
+  if (length < PLACE_ENTRY_HEADER_SIZE)
+  {
+    return 0;
+  }
+  const uint8_t hours = data[12];
+  const size_t name_at = PLACE_ENTRY_HEADER_SIZE + hours * 2;
+  if (hours > PLACE_FORECAST_HOURS || name_at + 1 > length || name_at + 1 + data[name_at] > length)
+  {
+    return 0;
+  }
+  place->updated = read_uint32_le(&data[0]);
+  place->weather = (PlaceWeather){
+      .temperature = (int8_t)data[4],
+      .high_temp = (int8_t)data[5],
+      .low_temp = (int8_t)data[6],
+      .conditions = data[7] & 0x0F,
+  };
+  place->forecast_start = read_uint32_le(&data[8]);
+  place->forecast_count = hours;
+  for (uint8_t i = 0; i < hours; i++)
+  {
+    place->hours[i] = (ForecastHour){
+        .temperature = (int8_t)data[PLACE_ENTRY_HEADER_SIZE + 2 * i],
+        .conditions = data[PLACE_ENTRY_HEADER_SIZE + 2 * i + 1] & 0x0F,
+    };
+  }
+  const uint8_t name_length = data[name_at] < PLACE_NAME_SIZE - 1 ? data[name_at] : PLACE_NAME_SIZE - 1;
+  memcpy(place->name, &data[name_at + 1], name_length);
+  place->name[name_length] = '\0';
+  return name_at + 1 + data[name_at];
+}
+
+bool places_store(const uint8_t *data, size_t length)
+{
+  if (length < 2 || data[0] != PLACES_PAYLOAD_VERSION || data[1] > PLACES_MAX)
+  {
+    return false;
+  }
+  Places places = {.version = PLACES_PAYLOAD_VERSION, .count = data[1]};
+  size_t offset = 2;
+  for (uint8_t i = 0; i < places.count; i++)
+  {
+    const size_t size = place_decode(&data[offset], length - offset, &places.places[i]);
+    if (!size)
+    {
+      return false;
+    }
+    offset += size;
+  }
+  s_places = places;
+  return true;
+}
+
+uint8_t places_count(void)
+{
+  return s_places.count;
+}
+
+const char *places_name(uint8_t index)
+{
+  return s_places.places[index].name;
+}
+
+PlaceWeather places_weather(uint8_t index, time_t now)
+{
+  const Place *place = &s_places.places[index];
+  PlaceWeather weather = place->weather;
+  if (now / SECONDS_PER_HOUR == (time_t)place->updated / SECONDS_PER_HOUR || now < (time_t)place->forecast_start)
+  {
+    return weather;
+  }
+  const uint32_t hour = (now - place->forecast_start) / SECONDS_PER_HOUR;
+  if (hour < place->forecast_count)
+  {
+    weather.temperature = place->hours[hour].temperature;
+    weather.conditions = place->hours[hour].conditions;
+  }
+  return weather;
+}
+
+void places_load(uint32_t persist_key)
+{
+  if (persist_read_data(persist_key, &s_places, sizeof(s_places)) != (int)sizeof(s_places) ||
+      s_places.version != PLACES_PAYLOAD_VERSION || s_places.count > PLACES_MAX)
+  {
+    memset(&s_places, 0, sizeof(s_places));
+  }
+}
+
+void places_save(uint32_t persist_key)
+{
+  persist_write_data(persist_key, &s_places, sizeof(s_places));
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <pebble.h>
+#include "forecast.h"
+
+// Weather for the places saved on the settings page, cached on the watch so
+// a wrist tap can switch the face to one of them without asking the phone.
+// The phone refreshes the whole table in one PLACES message, packed by
+// packPlaces() in src/pkjs/index.js on the schedule kept by
+// src/pkjs/places.js:
+//   [0]       format version, PLACES_PAYLOAD_VERSION
+//   [1]       number of places N, at most PLACES_MAX, then N entries of:
+//     [0..3]  when the reading was taken, unix time, little-endian
+//     [4..6]  current, high and low temperature, int8
+//     [7]     condition index in the low nibble (0x0F when unknown)
+//     [8..11] start of the first forecast hour, unix time, little-endian
+//     [12]    number of hours H, at most PLACE_FORECAST_HOURS, then H
+//             entries laid out as in the forecast payload
+//     then    name length L, followed by L bytes of UTF-8, unterminated
+//
+// The table is static and persisted as one blob: PLACES_MAX entries of
+// 45 bytes plus a 2-byte header, 137 bytes on every platform including
+// aplite, well under PERSIST_DATA_MAX_LENGTH.
+
+#define PLACES_PAYLOAD_VERSION 1
+#define PLACES_MAX 3
+#define PLACE_FORECAST_HOURS 6
+#define PLACE_NAME_SIZE 20
+
+typedef struct
+{
+  int8_t temperature;
+  int8_t high_temp;
+  int8_t low_temp;
+  // Condition index, 0x0F when unknown.
+  uint8_t conditions;
+} PlaceWeather;
+
+// Replaces the table with a payload. Returns false if it is malformed.
+bool places_store(const uint8_t *data, size_t length);
+
+uint8_t places_count(void);
+
+const char *places_name(uint8_t index);
+
+// The weather at a place as of now: its reading while that is from the
+// current hour, then the forecast hour covering now, and the reading again
+// once the forecast runs out.
+PlaceWeather places_weather(uint8_t index, time_t now);
+
+void places_load(uint32_t persist_key);
+void places_save(uint32_t persist_key);
@@ -0,0 +1,153 @@
+#include "step_history.h"
+
+#define STEP_HISTORY_VERSION 1
+#define SECONDS_PER_HOUR 3600
+// Minute records younger than this may still be written to.
+#define STEP_HISTORY_SETTLE_SECONDS (2 * 60)
+
+// head is the bucket of the hour starting at head_hour; the buckets before
+// it, wrapping around, are the hours before that.
+typedef struct __attribute__((__packed__))
+{
+  uint8_t version;
+  uint32_t head_hour;
+  uint32_t synced_until;
+  uint8_t head;
+  uint16_t buckets[STEP_HISTORY_HOURS];
+} StepHistory;
+
+static StepHistory s_history;
+
+static time_t hour_start(time_t time)
+{
+  return time - time % SECONDS_PER_HOUR;
+}
+
+static time_t settled_until(time_t now)
+{
+  const time_t until = now - STEP_HISTORY_SETTLE_SECONDS;
+  return until - until % 60;
+}
+
+static void reset(time_t hour)
+{
+  memset(&s_history, 0, sizeof(s_history));
+  s_history.version = STEP_HISTORY_VERSION;
+  s_history.head_hour = hour;
+}
+
+// Moves the head to the given hour, emptying the buckets it passes.
+static bool advance_to(time_t hour)
+{
+  if (hour == (time_t)s_history.head_hour)
+  {
+    return false;
+  }
+  if (hour < (time_t)s_history.head_hour || hour - (time_t)s_history.head_hour >= STEP_HISTORY_HOURS * SECONDS_PER_HOUR)
+  {
+    // The clock went back, or nothing in the ring is recent enough to keep.
+    reset(hour);
+    return true;
+  }
+  while ((time_t)s_history.head_hour < hour)
+  {
+    s_history.head = (s_history.head + 1) % STEP_HISTORY_HOURS;
+    s_history.buckets[s_history.head] = 0;
+    s_history.head_hour += SECONDS_PER_HOUR;
+  }
+  return true;
+}
+
+// Index of the bucket holding the given time, or -1 if the ring does not.
+static int bucket_for(time_t time)
+{
+  if (time >= (time_t)s_history.head_hour + SECONDS_PER_HOUR)
+  {
+    return -1;
+  }
+  const int ago = ((time_t)s_history.head_hour - hour_start(time)) / SECONDS_PER_HOUR;
+  if (ago >= STEP_HISTORY_HOURS)
+  {
+    return -1;
+  }
+  return (s_history.head + STEP_HISTORY_HOURS - ago) % STEP_HISTORY_HOURS;
+}
+
+bool step_history_sync(time_t now)
+{
+  bool changed = advance_to(hour_start(now));
+  const time_t until = settled_until(now);
+  const time_t oldest = (time_t)s_history.head_hour - (STEP_HISTORY_HOURS - 1) * SECONDS_PER_HOUR;
+  time_t start = s_history.synced_until;
+  if (start < oldest)
+  {
+    start = oldest;
+  }
+  if (start >= until)
+  {
+    return changed;
+  }
+  time_t end = until;
+  if (end - start > STEP_HISTORY_SYNC_MINUTES * 60)
+  {
+    end = start + STEP_HISTORY_SYNC_MINUTES * 60;
+  }
+
+  HealthMinuteData minutes[STEP_HISTORY_SYNC_MINUTES];
+  time_t first = start;
+  time_t last = end;
+  const uint32_t count = health_service_get_minute_history(minutes, STEP_HISTORY_SYNC_MINUTES, &first, &last);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    const time_t minute = first + i * 60;
+    const int bucket = bucket_for(minute);
+    if (minute < start || minute >= end || bucket < 0 || minutes[i].is_invalid || !minutes[i].steps)
+    {
+      continue;
+    }
+    const uint16_t steps = s_history.buckets[bucket];
+    s_history.buckets[bucket] = steps > UINT16_MAX - minutes[i].steps ? UINT16_MAX : steps + minutes[i].steps;
+    changed = true;
+  }
+  s_history.synced_until = end;
+  return changed;
+}
+
+void step_history_rebuild(time_t now)
+{
+  reset(hour_start(now));
+  const time_t until = settled_until(now);
+  for (int ago = 0; ago < STEP_HISTORY_HOURS; ago++)
+  {
+    const time_t start = (time_t)s_history.head_hour - ago * SECONDS_PER_HOUR;
+    const time_t end = start + SECONDS_PER_HOUR < until ? start + SECONDS_PER_HOUR : until;
+    if (end > start)
+    {
+      const HealthValue steps = health_service_sum(HealthMetricStepCount, start, end);
+      s_history.buckets[bucket_for(start)] = steps > UINT16_MAX ? UINT16_MAX : steps;
+    }
+  }
+  s_history.synced_until = until;
+}
+
+uint16_t step_history_get(time_t time)
+{
+  const int bucket = bucket_for(time);
+  return bucket < 0 ? 0 : s_history.buckets[bucket];
+}
+
+bool step_history_load(uint32_t persist_key)
+{
+  if (persist_read_data(persist_key, &s_history, sizeof(s_history)) != (int)sizeof(s_history) ||
+      s_history.version != STEP_HISTORY_VERSION || s_history.head >= STEP_HISTORY_HOURS)
+  {
+    memset(&s_history, 0, sizeof(s_history));
+    return false;
+  }
+  return true;
+}
+
+void step_history_save(uint32_t persist_key)
+{
+  persist_write_data(persist_key, &s_history, sizeof(s_history));
+}
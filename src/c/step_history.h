@@ -0,0 +1,29 @@
+#pragma once
+
+#include <pebble.h>
+
+// Steps per hour over the last STEP_HISTORY_HOURS hours, for the sparkline
+// under the health ring. The ring is filled from minute history a few
+// minutes at a time, so keeping it current never scans more than
+// STEP_HISTORY_SYNC_MINUTES records per call, and it is persisted so a
+// restart picks up where it left off instead of re-reading the day.
+
+#define STEP_HISTORY_HOURS 24
+#define STEP_HISTORY_SYNC_MINUTES 15
+
+// Reads minute history from where the last sync stopped, at most
+// STEP_HISTORY_SYNC_MINUTES of it, leaving out the last couple of minutes
+// the firmware may still be writing. A ring further behind catches up over
+// the following calls. Returns whether any bucket changed.
+bool step_history_sync(time_t now);
+
+// Refills every bucket with hourly sums, for when the firmware reports that
+// past data changed or there is no stored history.
+void step_history_rebuild(time_t now);
+
+// Steps in the hour containing time, or 0 if the ring does not reach it.
+uint16_t step_history_get(time_t time);
+
+// Whether the stored ring was usable; if not it starts empty.
+bool step_history_load(uint32_t persist_key);
+void step_history_save(uint32_t persist_key);
@@ -0,0 +1,44 @@
+// Expiring key/value store kept as a single JSON object in localStorage, so
+// stale entries can be pruned on write without enumerating localStorage.
+function Cache(storageKey, retainMs) {
+  this.storageKey = storageKey;
+  this.retainMs = retainMs;
+}
+
+Cache.prototype.load = function () {
+  try {
+    return JSON.parse(localStorage.getItem(this.storageKey)) || {};
+  } catch (e) {
+    return {};
+  }
+};
+
+// Returns the value stored under key if it is younger than maxAgeMs.
+Cache.prototype.get = function (key, maxAgeMs, now) {
+  var entry = this.load()[key];
+  if (!entry || now - entry.at > maxAgeMs || entry.at > now) {
+    return undefined;
+  }
+  return entry.value;
+};
+
+Cache.prototype.put = function (key, value, now) {
+  var entries = this.load();
+  for (var existing in entries) {
+    if (now - entries[existing].at > this.retainMs) {
+      delete entries[existing];
+    }
+  }
+  entries[key] = { at: now, value: value };
+  localStorage.setItem(this.storageKey, JSON.stringify(entries));
+};
+
+// Rounds a coordinate pair to a grid cell about a kilometre across.
+function cellKey(lat, lon) {
+  return lat.toFixed(2) + "," + lon.toFixed(2);
+}
+
+module.exports = {
+  Cache: Cache,
+  cellKey: cellKey,
+};
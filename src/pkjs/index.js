@@ -1,111 +1,200 @@
 var Clay = require("pebble-clay");
 var clayConfig = require("./config");
-var clay = new Clay(clayConfig);
-
-function weatherIdToIconIndex(weatherId) {
-  var weatherCodes = {
-    clear: [0, 1],
-    clouds: [2, 3],
-    fog: [45, 48],
-    rain: [51, 53, 55, 56, 57, 61, 63, 65, 66, 67, 80, 81, 82],
-    snow: [71, 73, 75, 77, 85, 86],
-    storm: [95, 96, 99],
-  };
-  for (var key in weatherCodes) {
-    if (weatherCodes[key].indexOf(weatherId) !== -1) {
-      return Object.keys(weatherCodes).indexOf(key);
-    }
+var clay = new Clay(clayConfig, null, { autoHandleEvents: false });
+var messageKeys = require("message_keys");
+var Outbox = require("./outbox").Outbox;
+var perf = require("./perf");
+var SavedPlaces = require("./places").SavedPlaces;
+var SettingsSync = require("./settings").SettingsSync;
+var WeatherPipeline = require("./weather").WeatherPipeline;
+
+var outbox = new Outbox();
+
+// Must match WEATHER_PAYLOAD_VERSION and the layout documented above
+// weather_payload_decode() in src/c/modulus.c.
+var WEATHER_PAYLOAD_VERSION = 1;
+var WEATHER_CONDITIONS_UNKNOWN = 0x0f;
+var WEATHER_LOCATION_MAX_BYTES = 63;
+
+function pushInt16(bytes, value) {
+  bytes.push(value & 0xff, (value >> 8) & 0xff);
+}
+
+function pushUint32(bytes, value) {
+  bytes.push(value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff, (value >>> 24) & 0xff);
+}
+
+function int8Byte(value) {
+  return Math.max(-128, Math.min(127, Math.round(value))) & 0xff;
+}
+
+// Unknown codes are undefined, or null once cached as JSON.
+function conditionsByte(conditions) {
+  return typeof conditions !== "number" ? WEATHER_CONDITIONS_UNKNOWN : conditions & 0x0f;
+}
+
+// UTF-8 bytes of name, cut at a character boundary to fit maxBytes, by
+// default the watch's location buffer.
+function locationBytes(name, maxBytes) {
+  var utf8 = unescape(encodeURIComponent(name || ""));
+  var length = Math.min(utf8.length, maxBytes || WEATHER_LOCATION_MAX_BYTES);
+  while (length > 0 && length < utf8.length &&
+         (utf8.charCodeAt(length) & 0xc0) === 0x80) {
+    length--;
+  }
+  var bytes = [];
+  for (var i = 0; i < length; i++) {
+    bytes.push(utf8.charCodeAt(i));
   }
+  return bytes;
 }
 
-function sendMessage(message) {
-  Pebble.sendAppMessage(
-    message,
-    function (e) {
-      console.log("Weather info sent to Pebble successfully!");
-    },
-    function (e) {
-      console.log("Error sending weather info to Pebble!");
+function packWeather(weather) {
+  var bytes = [WEATHER_PAYLOAD_VERSION];
+  pushInt16(bytes, weather.temperature);
+  pushInt16(bytes, weather.high);
+  pushInt16(bytes, weather.low);
+  bytes.push(conditionsByte(weather.conditions));
+  var location = locationBytes(weather.location);
+  bytes.push(location.length);
+  return bytes.concat(location);
+}
+
+// Must match FORECAST_PAYLOAD_VERSION and the layout in src/c/forecast.h.
+var FORECAST_PAYLOAD_VERSION = 1;
+var FORECAST_HOURS = 24;
+
+function packForecast(forecast) {
+  var start = forecast.start;
+  var count = Math.min(forecast.temperatures.length, FORECAST_HOURS);
+  var bytes = [FORECAST_PAYLOAD_VERSION];
+  pushUint32(bytes, start);
+  bytes.push(count);
+  for (var i = 0; i < count; i++) {
+    bytes.push(int8Byte(forecast.temperatures[i]), conditionsByte(forecast.conditions[i]));
+  }
+  return bytes;
+}
+
+// Must match PLACES_PAYLOAD_VERSION and the layout in src/c/places.h.
+var PLACES_PAYLOAD_VERSION = 1;
+var PLACE_FORECAST_HOURS = 6;
+var PLACE_NAME_MAX_BYTES = 19;
+
+function packPlaces(places) {
+  var bytes = [PLACES_PAYLOAD_VERSION, places.length];
+  places.forEach(function (place) {
+    var weather = place.weather;
+    var at = Math.floor(place.at / 1000);
+    pushUint32(bytes, at);
+    bytes.push(int8Byte(weather.temperature), int8Byte(weather.high), int8Byte(weather.low),
+      conditionsByte(weather.conditions));
+    // The reading covers its own hour; the forecast starts at the next one.
+    var forecast = weather.forecast || { start: at, temperatures: [], conditions: [] };
+    var first = Math.max(0, Math.floor((at - forecast.start) / 3600) + 1);
+    var count = Math.max(0, Math.min(forecast.temperatures.length - first, PLACE_FORECAST_HOURS));
+    pushUint32(bytes, forecast.start + first * 3600);
+    bytes.push(count);
+    for (var i = first; i < first + count; i++) {
+      bytes.push(int8Byte(forecast.temperatures[i]), conditionsByte(forecast.conditions[i]));
     }
-  );
+    var name = locationBytes(place.name, PLACE_NAME_MAX_BYTES);
+    bytes.push(name.length);
+    bytes.push.apply(bytes, name);
+  });
+  return bytes;
 }
 
-function getLocation(lat, lon, api_key, message) {
-  var location_request = new XMLHttpRequest();
-  location_request.onload = function () {
-    var location_response = JSON.parse(location_request.responseText);
-    message.LOCATION = location_response[0].name;
-    sendMessage(message);
-  };
-  var owm_url =
-    "http://api.openweathermap.org/geo/1.0/reverse?lat=" +
-    lat +
-    "&lon=" +
-    lon +
-    "&appid=" +
-    api_key;
-  location_request.open("GET", owm_url);
-  location_request.send();
+function sendWeather(weather) {
+  var message = { WEATHER: packWeather(weather) };
+  if (weather.forecast) {
+    message.FORECAST = packForecast(weather.forecast);
+  }
+  if (perf.dumpDue(Date.now())) {
+    message.PERF_DUMP = 1;
+  }
+  // Weather still waiting to go out is stale once this one exists.
+  outbox.replace("weather", message, function (error) {
+    if (error) {
+      console.log("Weather not sent to Pebble: " + error.message);
+    } else {
+      console.log("Weather info sent to Pebble successfully!");
+    }
+  });
 }
 
+var pipeline = new WeatherPipeline({
+  geolocate: function (callback) {
+    navigator.geolocation.getCurrentPosition(
+      function (pos) {
+        callback(null, pos.coords);
+      },
+      function (err) {
+        console.log("Error requesting location!");
+        callback(err);
+      },
+      {
+        timeout: 15000,
+        maximumAge: 60000,
+      }
+    );
+  },
+  send: sendWeather,
+});
+
+var savedPlaces = new SavedPlaces({
+  fetchForecast: function (cell, settings, result) {
+    pipeline.fetchForecast(cell, settings, result);
+  },
+  send: function (places, done) {
+    // Only the newest table is worth sending.
+    outbox.replace("places", { PLACES: packPlaces(places) }, done);
+  },
+});
+
+// The saved places ride along with every weather request from the watch;
+// SavedPlaces decides which of them are due.
 function getWeatherData() {
   var settings = JSON.parse(localStorage.getItem("clay-settings")) || {};
-  var meteo_units = settings.UNITS === "F" ? "fahrenheit" : "celsius";
-  var owm_key = settings.OWM_API_KEY;
-  var location_name = settings.LOCATION_NAME || "My Location";
-  navigator.geolocation.getCurrentPosition(
-    function (pos) {
-      var weather_request = new XMLHttpRequest();
-      weather_request.onload = function () {
-        var weather_response = JSON.parse(weather_request.responseText);
-
-        var message = {
-          CUR_TEMP: Math.round(weather_response.current.temperature_2m),
-          HIGH_TEMP: Math.round(weather_response.daily.temperature_2m_max[0]),
-          LOW_TEMP: Math.round(weather_response.daily.temperature_2m_min[0]),
-          CONDITIONS: weatherIdToIconIndex(
-            weather_response.current.weather_code
-          ),
-          LOCATION: location_name,
-        };
-        if (owm_key) {
-          getLocation(
-            pos.coords.latitude,
-            pos.coords.longitude,
-            owm_key,
-            message
-          );
-        } else {
-          sendMessage(message);
-        }
-      };
-      var daily_url =
-        "https://api.open-meteo.com/v1/forecast?latitude=" +
-        pos.coords.latitude +
-        "&longitude=" +
-        pos.coords.longitude +
-        "&current=temperature_2m,weather_code" +
-        "&daily=temperature_2m_max,temperature_2m_min" +
-        "&temperature_unit=" +
-        meteo_units +
-        "&timezone=auto&forecast_days=1";
-      weather_request.open("GET", daily_url);
-      weather_request.send();
-    },
-    function (err) {
-      console.log("Error requesting location!");
-    },
-    {
-      timeout: 15000,
-      maximumAge: 60000,
+  pipeline.update(settings, function (error) {
+    if (error) {
+      console.log("No weather to send: " + error.message);
     }
-  );
+  });
+  savedPlaces.refresh(settings, function (error) {
+    if (error) {
+      console.log("Saved places not sent to Pebble: " + error.message);
+    }
+  });
 }
 
+// Saves made while one is still queued are merged into it.
+var settingsSync = new SettingsSync({
+  messageKeys: messageKeys,
+  send: function (watch, done) {
+    outbox.merge("config", watch, done);
+  },
+  refetch: getWeatherData,
+});
+
+Pebble.addEventListener("showConfiguration", function () {
+  Pebble.openURL(clay.generateUrl());
+});
+
+Pebble.addEventListener("webviewclosed", function (e) {
+  if (e && e.response) {
+    settingsSync.save(clay.getSettings(e.response));
+  }
+});
+
 Pebble.addEventListener("ready", function () {
   getWeatherData();
 });
 
 Pebble.addEventListener("appmessage", function (e) {
+  if (e.payload.PERF) {
+    perf.received(e.payload.PERF, Date.now());
+    return;
+  }
   getWeatherData();
 });
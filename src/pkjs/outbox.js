@@ -0,0 +1,147 @@
+// Sends AppMessages to the watch one at a time. A NACK, or a message the
+// watch never answers, is retried with exponential backoff, and at most one
+// message per kind waits in the queue: a newer one replaces it, or for kinds
+// that carry deltas, such as settings, is merged into it.
+var BASE_DELAY_MS = 1000;
+var MAX_ATTEMPTS = 5;
+var TIMEOUT_MS = 10000;
+
+function Outbox(options) {
+  options = options || {};
+  this.sendAppMessage = options.sendAppMessage || function (message, ack, nack) {
+    Pebble.sendAppMessage(message, ack, nack);
+  };
+  this.baseDelayMs = options.baseDelayMs || BASE_DELAY_MS;
+  this.maxAttempts = options.maxAttempts || MAX_ATTEMPTS;
+  this.timeoutMs = options.timeoutMs || TIMEOUT_MS;
+  this.queue = [];
+  this.inFlight = null;
+  this.retryTimer = null;
+}
+
+function finish(entry, error) {
+  entry.callbacks.forEach(function (callback) {
+    callback(error);
+  });
+}
+
+// Copies the keys of from that into does not have yet.
+function mergeUnder(into, from) {
+  for (var key in from) {
+    if (!(key in into)) {
+      into[key] = from[key];
+    }
+  }
+}
+
+Outbox.prototype.waiting = function (kind) {
+  for (var i = 0; i < this.queue.length; i++) {
+    if (this.queue[i].kind === kind) {
+      return this.queue[i];
+    }
+  }
+  return null;
+};
+
+Outbox.prototype.add = function (kind, message, callback, merges) {
+  var entry = this.waiting(kind);
+  if (entry && merges) {
+    var merged = {};
+    mergeUnder(merged, message);
+    mergeUnder(merged, entry.message);
+    entry.message = merged;
+  } else if (entry) {
+    finish(entry, new Error("superseded"));
+    entry.message = message;
+    entry.callbacks = [];
+  } else {
+    entry = { kind: kind, message: message, callbacks: [], attempts: 0, merges: merges };
+    this.queue.push(entry);
+  }
+  if (callback) {
+    entry.callbacks.push(callback);
+  }
+  this.pump();
+};
+
+// Queues message in place of a waiting one of the same kind, which is
+// dropped. callback(error) runs once it is delivered or given up on.
+Outbox.prototype.replace = function (kind, message, callback) {
+  this.add(kind, message, callback, false);
+};
+
+// Queues message merged over a waiting one of the same kind, its keys
+// winning; every merged callback gets the outcome of the combined message.
+Outbox.prototype.merge = function (kind, message, callback) {
+  this.add(kind, message, callback, true);
+};
+
+Outbox.prototype.failed = function (entry, error) {
+  if (entry.attempts >= this.maxAttempts) {
+    console.log("Giving up on " + entry.kind + " after " + entry.attempts + " attempts: " + error.message);
+    finish(entry, error);
+    return;
+  }
+  // Something newer of the same kind may have been queued while this was in
+  // flight; it goes out instead, carrying this one's keys if they merge.
+  var newer = this.waiting(entry.kind);
+  if (newer && entry.merges) {
+    mergeUnder(newer.message, entry.message);
+    newer.callbacks = entry.callbacks.concat(newer.callbacks);
+  } else if (newer) {
+    finish(entry, new Error("superseded"));
+  } else {
+    this.queue.unshift(entry);
+  }
+  var self = this;
+  this.retryTimer = setTimeout(function () {
+    self.retryTimer = null;
+    self.pump();
+  }, this.baseDelayMs * Math.pow(2, entry.attempts - 1));
+};
+
+Outbox.prototype.pump = function () {
+  if (this.inFlight || this.retryTimer || !this.queue.length) {
+    return;
+  }
+  var self = this;
+  var entry = this.queue.shift();
+  var timer = null;
+  var settled = false;
+  this.inFlight = entry;
+  entry.attempts++;
+
+  // The watch's ACK or NACK can still arrive after the timeout; only the
+  // first outcome of each attempt counts.
+  function settle(error) {
+    if (settled) {
+      return;
+    }
+    settled = true;
+    clearTimeout(timer);
+    self.inFlight = null;
+    if (error) {
+      self.failed(entry, error);
+    } else {
+      finish(entry, null);
+    }
+    self.pump();
+  }
+
+  timer = setTimeout(function () {
+    settle(new Error("timeout"));
+  }, this.timeoutMs);
+  this.sendAppMessage(
+    entry.message,
+    function () {
+      settle(null);
+    },
+    function () {
+      settle(new Error("nack"));
+    }
+  );
+};
+
+module.exports = {
+  Outbox: Outbox,
+};
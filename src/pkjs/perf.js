@@ -0,0 +1,110 @@
+// Decodes the watch's PERF payload. Must match the layout documented above
+// perf_pack() in src/c/perf.h.
+var PERF_PAYLOAD_VERSION = 1;
+var PERF_PAYLOAD_HEADER_SIZE = 34;
+var PERF_PAYLOAD_EVENT_SIZE = 6;
+var PERF_DUMP_INTERVAL_MS = 6 * 60 * 60 * 1000;
+var LAST_DUMP_KEY = "perf-last-dump";
+
+var EVENT_NAMES = {
+  1: "inbox_dropped",
+  2: "outbox_failed",
+  3: "weather_latency",
+  4: "slow_draw",
+  5: "heap_low",
+  6: "weather_timeout",
+};
+var DRAW_NAMES = ["temperature", "health", "battery"];
+
+function u16(bytes, i) {
+  return bytes[i] | (bytes[i + 1] << 8);
+}
+
+function u32(bytes, i) {
+  return u16(bytes, i) + u16(bytes, i + 2) * 65536;
+}
+
+function unpack(bytes) {
+  if (!bytes || bytes.length < PERF_PAYLOAD_HEADER_SIZE ||
+      bytes[0] !== PERF_PAYLOAD_VERSION) {
+    return null;
+  }
+  var stats = {
+    uptimeS: u32(bytes, 1),
+    inboxReceived: u16(bytes, 5),
+    inboxDropped: u16(bytes, 7),
+    outboxSent: u16(bytes, 9),
+    outboxFailed: u16(bytes, 11),
+    weatherReplies: u16(bytes, 13),
+    weatherLatencyMaxMs: u16(bytes, 15),
+    weatherLatencyTotalMs: u32(bytes, 17),
+    weatherTimeouts: u16(bytes, 21),
+    drawMaxMs: {},
+    heapFreeMin: u32(bytes, 29),
+    events: [],
+  };
+  for (var d = 0; d < DRAW_NAMES.length; d++) {
+    stats.drawMaxMs[DRAW_NAMES[d]] = u16(bytes, 23 + 2 * d);
+  }
+  var count = bytes[PERF_PAYLOAD_HEADER_SIZE - 1];
+  for (var i = 0; i < count; i++) {
+    var at = PERF_PAYLOAD_HEADER_SIZE + i * PERF_PAYLOAD_EVENT_SIZE;
+    if (at + PERF_PAYLOAD_EVENT_SIZE > bytes.length) {
+      break;
+    }
+    var kind = EVENT_NAMES[bytes[at]] || "unknown_" + bytes[at];
+    stats.events.push({
+      kind: kind,
+      detail: kind === "slow_draw" ? DRAW_NAMES[bytes[at + 1]] : bytes[at + 1],
+      value: u16(bytes, at + 2),
+      ageS: u16(bytes, at + 4),
+    });
+  }
+  return stats;
+}
+
+function format(stats) {
+  var latencyAvg = stats.weatherReplies
+    ? Math.round(stats.weatherLatencyTotalMs / stats.weatherReplies)
+    : 0;
+  var lines = [
+    "perf: up " + stats.uptimeS + "s" +
+      ", inbox " + stats.inboxReceived + " ok / " + stats.inboxDropped + " dropped" +
+      ", outbox " + stats.outboxSent + " ok / " + stats.outboxFailed + " failed",
+    "perf: weather " + stats.weatherReplies + " replies, avg " + latencyAvg +
+      "ms, max " + stats.weatherLatencyMaxMs + "ms, " +
+      stats.weatherTimeouts + " timeouts",
+    "perf: slowest draws " + JSON.stringify(stats.drawMaxMs) +
+      ", lowest free heap " + stats.heapFreeMin + " bytes",
+  ];
+  for (var i = 0; i < stats.events.length; i++) {
+    var e = stats.events[i];
+    lines.push("perf: -" + e.ageS + "s " + e.kind + " " + e.detail + " " + e.value);
+  }
+  return lines.join("\n");
+}
+
+// Whether the next message to the watch should ask for a dump.
+function dumpDue(now) {
+  var last = parseInt(localStorage.getItem(LAST_DUMP_KEY), 10);
+  return isNaN(last) || now - last >= PERF_DUMP_INTERVAL_MS || last > now;
+}
+
+// Logs a dump and keeps the latest one for later inspection.
+function received(bytes, now) {
+  var stats = unpack(bytes);
+  if (!stats) {
+    console.log("perf: unreadable payload");
+    return;
+  }
+  localStorage.setItem(LAST_DUMP_KEY, String(now));
+  localStorage.setItem("perf-last", JSON.stringify(stats));
+  console.log(format(stats));
+}
+
+module.exports = {
+  unpack: unpack,
+  format: format,
+  dumpDue: dumpDue,
+  received: received,
+};
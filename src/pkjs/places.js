@@ -0,0 +1,128 @@
+var cache = require("./cache");
+var all = require("./weather").all;
+
+// Must match PLACES_MAX in src/c/places.h.
+var PLACES_MAX = 3;
+var REFRESH_MS = 60 * 60 * 1000;
+var STATE_KEY = "places-state";
+
+// Reads the Saved Places setting, "Home: 43.45, -80.49; Work: 43.47, -80.54",
+// into [{ name, cell }], skipping entries that do not parse.
+function parsePlaces(text) {
+  var places = [];
+  String(text || "").split(";").forEach(function (entry) {
+    var match = /^\s*(.+?)\s*:\s*(-?\d+(?:\.\d+)?)\s*,\s*(-?\d+(?:\.\d+)?)\s*$/.exec(entry);
+    if (match && places.length < PLACES_MAX) {
+      places.push({ name: match[1], cell: cache.cellKey(parseFloat(match[2]), parseFloat(match[3])) });
+    }
+  });
+  return places;
+}
+
+// Keeps the weather for the saved places that the watch caches. Each
+// refresh() fetches the places that are due and sends the whole table in
+// one message if it differs from the last one the watch acknowledged.
+// A place is due REFRESH_MS after its last fetch. Besides places never
+// fetched, a refresh takes at most one due place, the stalest, so the
+// fetches spread over successive weather requests instead of bunching up.
+//
+// options.fetchForecast(cell, settings, result) reports result(weather),
+// or result() on failure, where weather.fetchedAt is when the reading was
+// fetched: an older fallback keeps its own time, so the place stays due and
+// the watch places its forecast hours correctly. options.send(places, done)
+// delivers [{ name, at, weather }] in settings order and calls done(error).
+function SavedPlaces(options) {
+  this.fetchForecast = options.fetchForecast;
+  this.send = options.send;
+  this.now = options.now || Date.now;
+}
+
+SavedPlaces.prototype.load = function () {
+  try {
+    var state = JSON.parse(localStorage.getItem(STATE_KEY));
+    return state && state.fetched ? state : { fetched: {} };
+  } catch (e) {
+    return { fetched: {} };
+  }
+};
+
+SavedPlaces.prototype.store = function (state) {
+  localStorage.setItem(STATE_KEY, JSON.stringify(state));
+};
+
+// callback(error) runs once the table is sent, or straight away when
+// nothing changed.
+SavedPlaces.prototype.refresh = function (settings, callback) {
+  var self = this;
+  var units = settings.UNITS === "F" ? "F" : "C";
+  var places = parsePlaces(settings.SAVED_PLACES).map(function (place) {
+    return { name: place.name, cell: place.cell, key: place.cell + "|" + units };
+  });
+  var state = this.load();
+  var now = this.now();
+  var due = [];
+  var stalest = null;
+  places.forEach(function (place) {
+    var fetched = state.fetched[place.key];
+    if (!fetched) {
+      due.push(place);
+    } else if (now - fetched.at >= REFRESH_MS && (!stalest || fetched.at < state.fetched[stalest.key].at)) {
+      stalest = place;
+    }
+  });
+  if (stalest) {
+    due.push(stalest);
+  }
+
+  function fetched(results) {
+    var state = self.load();
+    var kept = {};
+    results.forEach(function (weather, i) {
+      // Weather cached before fetchedAt was recorded has no known age.
+      if (weather && typeof weather.fetchedAt === "number") {
+        state.fetched[due[i].key] = { at: weather.fetchedAt, weather: weather };
+      }
+    });
+    var table = [];
+    places.forEach(function (place) {
+      var entry = state.fetched[place.key];
+      if (entry) {
+        kept[place.key] = entry;
+        table.push({ name: place.name, at: entry.at, weather: entry.weather });
+      }
+    });
+    state.fetched = kept;
+    self.store(state);
+
+    // The watch starts with an empty table.
+    var signature = JSON.stringify(table);
+    if (signature === (state.sent || "[]")) {
+      callback(null);
+      return;
+    }
+    self.send(table, function (error) {
+      if (!error) {
+        var state = self.load();
+        state.sent = signature;
+        self.store(state);
+      }
+      callback(error);
+    });
+  }
+
+  if (!due.length) {
+    fetched([]);
+    return;
+  }
+  all(due.map(function (place) {
+    return function (result) {
+      self.fetchForecast(place.cell, settings, result);
+    };
+  }), fetched);
+};
+
+module.exports = {
+  SavedPlaces: SavedPlaces,
+  parsePlaces: parsePlaces,
+  PLACES_MAX: PLACES_MAX,
+};
@@ -0,0 +1,93 @@
+// The Clay values the watch has acknowledged, so a settings save only sends
+// what changed since.
+var ACKED_KEY = "clay-acked";
+
+function loadAcked() {
+  try {
+    return JSON.parse(localStorage.getItem(ACKED_KEY)) || {};
+  } catch (e) {
+    return {};
+  }
+}
+
+// The entries of settings whose value differs from the acknowledged one.
+function changed(settings) {
+  var acked = loadAcked();
+  var delta = {};
+  for (var key in settings) {
+    if (JSON.stringify(settings[key]) !== JSON.stringify(acked[key])) {
+      delta[key] = settings[key];
+    }
+  }
+  return delta;
+}
+
+function acknowledge(delta) {
+  var acked = loadAcked();
+  for (var key in delta) {
+    acked[key] = delta[key];
+  }
+  localStorage.setItem(ACKED_KEY, JSON.stringify(acked));
+}
+
+// Settings only the phone reads; they never go to the watch. A change to
+// one of the weather inputs refetches straight away.
+var WEATHER_INPUT_KEYS = ["OWM_API_KEY", "LOCATION_NAME", "UNITS", "SAVED_PLACES"];
+var PHONE_ONLY_KEYS = WEATHER_INPUT_KEYS.concat(["WEATHER_CACHE_MINUTES"]);
+
+// Sends the watch only the settings that changed since it last acknowledged
+// a save; phone-only settings are acknowledged as soon as they are saved.
+//
+// options.send(delta, done) delivers the watch settings and calls
+// done(error); options.refetch() runs when a weather input changed.
+// Clay may key the settings by name or by numeric message key, so
+// options.messageKeys maps names to those numbers.
+function SettingsSync(options) {
+  this.send = options.send;
+  this.refetch = options.refetch;
+  this.messageKeys = options.messageKeys || {};
+}
+
+SettingsSync.prototype.isOneOf = function (key, names) {
+  var messageKeys = this.messageKeys;
+  return names.some(function (name) {
+    return key === name || key === String(messageKeys[name]);
+  });
+};
+
+SettingsSync.prototype.save = function (settings) {
+  var delta = changed(settings);
+  var phone = {};
+  var watch = {};
+  var watchChanged = false;
+  var weatherChanged = false;
+  for (var key in delta) {
+    if (this.isOneOf(key, PHONE_ONLY_KEYS)) {
+      phone[key] = delta[key];
+      weatherChanged = weatherChanged || this.isOneOf(key, WEATHER_INPUT_KEYS);
+    } else {
+      watch[key] = delta[key];
+      watchChanged = true;
+    }
+  }
+  acknowledge(phone);
+  if (weatherChanged) {
+    this.refetch();
+  }
+  if (!watchChanged) {
+    return;
+  }
+  this.send(watch, function (error) {
+    if (error) {
+      console.log("Settings not sent to Pebble (" + error.message + "); the next save resends them.");
+    } else {
+      acknowledge(watch);
+    }
+  });
+};
+
+module.exports = {
+  SettingsSync: SettingsSync,
+  changed: changed,
+  acknowledge: acknowledge,
+};
@@ -0,0 +1,301 @@
+var cache = require("./cache");
+
+var FORECAST_HOURS = 24;
+var GEOCODE_TTL_MS = 7 * 24 * 60 * 60 * 1000;
+var FORECAST_RETAIN_MS = 2 * 60 * 60 * 1000;
+var LAST_GOOD_RETAIN_MS = 24 * 60 * 60 * 1000;
+var POSITION_MAX_AGE_MS = 15 * 60 * 1000;
+var REQUEST_TIMEOUT_MS = 10000;
+var DEFAULT_CACHE_MINUTES = 30;
+var LAST_CELL_KEY = "weather-last-cell";
+
+var FORECAST_URL = "https://api.open-meteo.com/v1/forecast";
+var GEOCODE_URL = "http://api.openweathermap.org/geo/1.0/reverse";
+
+function weatherIdToIconIndex(weatherId) {
+  var weatherCodes = {
+    clear: [0, 1],
+    clouds: [2, 3],
+    fog: [45, 48],
+    rain: [51, 53, 55, 56, 57, 61, 63, 65, 66, 67, 80, 81, 82],
+    snow: [71, 73, 75, 77, 85, 86],
+    storm: [95, 96, 99],
+  };
+  for (var key in weatherCodes) {
+    if (weatherCodes[key].indexOf(weatherId) !== -1) {
+      return Object.keys(weatherCodes).indexOf(key);
+    }
+  }
+}
+
+// The next hours of an open-meteo hourly block, from the current hour on.
+function hourlyForecast(hourly) {
+  var forecast = { start: hourly.time[0], temperatures: [], conditions: [] };
+  for (var i = 0; i < hourly.time.length && i < FORECAST_HOURS; i++) {
+    forecast.temperatures.push(hourly.temperature_2m[i]);
+    forecast.conditions.push(weatherIdToIconIndex(hourly.weather_code[i]));
+  }
+  return forecast;
+}
+
+function parseForecast(response) {
+  var weather = {
+    temperature: Math.round(response.current.temperature_2m),
+    high: Math.round(response.daily.temperature_2m_max[0]),
+    low: Math.round(response.daily.temperature_2m_min[0]),
+    conditions: weatherIdToIconIndex(response.current.weather_code),
+  };
+  if (response.hourly && response.hourly.time) {
+    weather.forecast = hourlyForecast(response.hourly);
+  }
+  return weather;
+}
+
+// How long a forecast is reused, from the Weather Cache setting.
+function forecastMaxAge(settings) {
+  var cacheMinutes = parseInt(settings.WEATHER_CACHE_MINUTES, 10);
+  return (isNaN(cacheMinutes) ? DEFAULT_CACHE_MINUTES : cacheMinutes) * 60 * 1000;
+}
+
+function forecastUnits(settings) {
+  return settings.UNITS === "F" ? "fahrenheit" : "celsius";
+}
+
+function forecastHourKey(cell, settings, now) {
+  return cell + "|" + forecastUnits(settings) + "|" + Math.floor(now / (60 * 60 * 1000));
+}
+
+// GETs url and parses the body as JSON. callback(error, json) runs exactly
+// once: on success, on a network or HTTP error, or after timeoutMs.
+function getJson(url, timeoutMs, callback) {
+  var request = new XMLHttpRequest();
+  var finished = false;
+  function finish(error, json) {
+    if (finished) {
+      return;
+    }
+    finished = true;
+    clearTimeout(timer);
+    callback(error, json);
+  }
+  var timer = setTimeout(function () {
+    finish(new Error("timeout"));
+    request.abort();
+  }, timeoutMs);
+  request.onload = function () {
+    if (request.status < 200 || request.status >= 300) {
+      finish(new Error("HTTP " + request.status));
+      return;
+    }
+    try {
+      finish(null, JSON.parse(request.responseText));
+    } catch (e) {
+      finish(e);
+    }
+  };
+  request.onerror = function () {
+    finish(new Error("network error"));
+  };
+  request.open("GET", url);
+  request.send();
+}
+
+// Runs the tasks concurrently; done(results) gets their results in order
+// once the last one has called back.
+function all(tasks, done) {
+  var results = [];
+  var pending = tasks.length;
+  tasks.forEach(function (task, i) {
+    task(function (result) {
+      results[i] = result;
+      if (--pending === 0) {
+        done(results);
+      }
+    });
+  });
+}
+
+// Fetches weather for the watch. Concurrent update() calls share one run;
+// within a run the forecast and the place name are fetched side by side,
+// and either falls back to the last good answer if its request fails.
+//
+// options.geolocate(callback) reports a position as callback(error, coords);
+// options.send(weather) delivers the merged result. The URLs and the
+// timeout can be overridden for tests.
+function WeatherPipeline(options) {
+  this.geolocate = options.geolocate;
+  this.send = options.send;
+  this.forecastUrl = options.forecastUrl || FORECAST_URL;
+  this.geocodeUrl = options.geocodeUrl || GEOCODE_URL;
+  this.timeoutMs = options.timeoutMs || REQUEST_TIMEOUT_MS;
+  this.now = options.now || Date.now;
+  this.geocodeCache = new cache.Cache("geocode-cache", GEOCODE_TTL_MS);
+  this.forecastCache = new cache.Cache("forecast-cache", FORECAST_RETAIN_MS);
+  this.lastGood = new cache.Cache("weather-last-good", LAST_GOOD_RETAIN_MS);
+  this.waiting = null;
+}
+
+// callback(error, weather) runs when the shared run finishes.
+WeatherPipeline.prototype.update = function (settings, callback) {
+  var self = this;
+  if (this.waiting) {
+    if (callback) {
+      this.waiting.push(callback);
+    }
+    return;
+  }
+  this.waiting = callback ? [callback] : [];
+  this.run(settings, function (error, weather) {
+    var waiting = self.waiting;
+    self.waiting = null;
+    if (weather) {
+      self.send(weather);
+    }
+    waiting.forEach(function (waiter) {
+      waiter(error, weather);
+    });
+  });
+};
+
+WeatherPipeline.prototype.run = function (settings, done) {
+  var self = this;
+  this.locate(settings, function (error, cell) {
+    if (!cell) {
+      done(error || new Error("no position"));
+      return;
+    }
+    all([
+      function (result) {
+        self.fetchForecast(cell, settings, result);
+      },
+      function (result) {
+        self.fetchLocationName(cell, settings, result);
+      },
+    ], function (results) {
+      var weather = results[0];
+      if (!weather) {
+        done(new Error("no weather for " + cell));
+        return;
+      }
+      weather.location = results[1];
+      done(null, weather);
+    });
+  });
+};
+
+// Reuses the last cell while it is recent, or while its forecast is still
+// cached, so a fresh answer does not wait on GPS; a wearer who moved since
+// gets the new cell once that forecast ages out of the cache. Otherwise
+// asks for a position, and if that fails the last cell is still better
+// than nothing.
+WeatherPipeline.prototype.locate = function (settings, callback) {
+  var self = this;
+  var last = this.loadLastCell();
+  var now = this.now();
+  if (last && (now - last.at < POSITION_MAX_AGE_MS || this.cachedForecast(last.cell, settings, now))) {
+    callback(null, last.cell);
+    return;
+  }
+  this.geolocate(function (error, coords) {
+    if (error || !coords) {
+      callback(error, last && last.cell);
+      return;
+    }
+    var cell = cache.cellKey(coords.latitude, coords.longitude);
+    localStorage.setItem(LAST_CELL_KEY, JSON.stringify({ cell: cell, at: self.now() }));
+    callback(null, cell);
+  });
+};
+
+WeatherPipeline.prototype.loadLastCell = function () {
+  try {
+    var last = JSON.parse(localStorage.getItem(LAST_CELL_KEY));
+    return last && last.cell ? last : null;
+  } catch (e) {
+    return null;
+  }
+};
+
+// The forecast for the cell, units and hour, if it is still fresh.
+WeatherPipeline.prototype.cachedForecast = function (cell, settings, now) {
+  return this.forecastCache.get(forecastHourKey(cell, settings, now), forecastMaxAge(settings), now);
+};
+
+WeatherPipeline.prototype.fetchForecast = function (cell, settings, result) {
+  var self = this;
+  var units = forecastUnits(settings);
+  var now = this.now();
+  var hourKey = forecastHourKey(cell, settings, now);
+  var lastKey = cell + "|" + units;
+
+  var cached = this.cachedForecast(cell, settings, now);
+  if (cached) {
+    result(cached);
+    return;
+  }
+  var coords = cell.split(",");
+  var url =
+    this.forecastUrl +
+    "?latitude=" + coords[0] +
+    "&longitude=" + coords[1] +
+    "&current=temperature_2m,weather_code" +
+    "&daily=temperature_2m_max,temperature_2m_min" +
+    "&hourly=temperature_2m,weather_code&forecast_hours=" + FORECAST_HOURS +
+    "&timeformat=unixtime" +
+    "&temperature_unit=" + units +
+    "&timezone=auto&forecast_days=1";
+  getJson(url, this.timeoutMs, function (error, response) {
+    var weather;
+    try {
+      weather = !error && parseForecast(response);
+    } catch (e) {
+      error = e;
+    }
+    if (!weather) {
+      console.log("Forecast failed (" + error.message + "), using the last good one");
+      result(self.lastGood.get(lastKey, LAST_GOOD_RETAIN_MS, self.now()));
+      return;
+    }
+    // Cached copies and the last good fallback keep the time of the fetch.
+    weather.fetchedAt = self.now();
+    self.forecastCache.put(hourKey, weather, weather.fetchedAt);
+    self.lastGood.put(lastKey, weather, weather.fetchedAt);
+    result(weather);
+  });
+};
+
+// Names the cell from the geocode cache, or asks OWM when it has no entry.
+WeatherPipeline.prototype.fetchLocationName = function (cell, settings, result) {
+  var self = this;
+  var fallback = settings.LOCATION_NAME || "My Location";
+  if (!settings.OWM_API_KEY) {
+    result(fallback);
+    return;
+  }
+  var name = this.geocodeCache.get(cell, GEOCODE_TTL_MS, this.now());
+  if (name !== undefined) {
+    result(name);
+    return;
+  }
+  var coords = cell.split(",");
+  var url =
+    this.geocodeUrl +
+    "?lat=" + coords[0] +
+    "&lon=" + coords[1] +
+    "&appid=" + settings.OWM_API_KEY;
+  getJson(url, this.timeoutMs, function (error, response) {
+    if (!error && response && response[0] && response[0].name) {
+      self.geocodeCache.put(cell, response[0].name, self.now());
+      result(response[0].name);
+      return;
+    }
+    result(fallback);
+  });
+};
+
+module.exports = {
+  WeatherPipeline: WeatherPipeline,
+  getJson: getJson,
+  all: all,
+  FORECAST_HOURS: FORECAST_HOURS,
+};
@@ -0,0 +1,202 @@
+#!/usr/bin/env python3
+"""Packs equally sized PNG images side by side into one PNG atlas.
+
+Pure Python (zlib and struct only) so it runs inside the Pebble SDK's waf
+without extra packages. Sources must be non-interlaced; any bit depth and
+colour type PNG allows is accepted. If the sources are all palette images
+and their combined palette fits in 256 entries, the atlas is written as a
+palette image too, otherwise as 8-bit RGBA.
+
+    pack_atlas.py OUTPUT SOURCE...
+"""
+
+import struct
+import sys
+import zlib
+
+PNG_SIGNATURE = b"\x89PNG\r\n\x1a\n"
+
+GREYSCALE = 0
+TRUECOLOR = 2
+PALETTE = 3
+GREYSCALE_ALPHA = 4
+TRUECOLOR_ALPHA = 6
+
+CHANNELS = {GREYSCALE: 1, TRUECOLOR: 3, PALETTE: 1, GREYSCALE_ALPHA: 2, TRUECOLOR_ALPHA: 4}
+
+
+class Image(object):
+    def __init__(self, width, height, pixels, palette=None):
+        self.width = width
+        self.height = height
+        # Rows of palette indices when palette is set, else of RGBA tuples.
+        self.pixels = pixels
+        self.palette = palette
+
+
+def _chunks(data):
+    if data[:8] != PNG_SIGNATURE:
+        raise ValueError("not a PNG file")
+    offset = 8
+    while offset < len(data):
+        length, kind = struct.unpack(">I4s", data[offset:offset + 8])
+        yield kind, data[offset + 8:offset + 8 + length]
+        offset += 12 + length
+
+
+def _paeth(a, b, c):
+    p = a + b - c
+    pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+    if pa <= pb and pa <= pc:
+        return a
+    return b if pb <= pc else c
+
+
+def _unfilter(raw, height, stride, bpp):
+    rows = []
+    previous = bytearray(stride)
+    offset = 0
+    for _ in range(height):
+        kind = raw[offset]
+        row = bytearray(raw[offset + 1:offset + 1 + stride])
+        offset += 1 + stride
+        for i in range(stride):
+            left = row[i - bpp] if i >= bpp else 0
+            if kind == 1:
+                row[i] = (row[i] + left) & 0xFF
+            elif kind == 2:
+                row[i] = (row[i] + previous[i]) & 0xFF
+            elif kind == 3:
+                row[i] = (row[i] + ((left + previous[i]) >> 1)) & 0xFF
+            elif kind == 4:
+                up_left = previous[i - bpp] if i >= bpp else 0
+                row[i] = (row[i] + _paeth(left, previous[i], up_left)) & 0xFF
+            elif kind != 0:
+                raise ValueError("bad filter type %d" % kind)
+        rows.append(row)
+        previous = row
+    return rows
+
+
+def _samples(row, count, depth):
+    if depth == 8:
+        return list(row[:count])
+    if depth == 16:
+        return [row[2 * i] for i in range(count)]
+    per_byte = 8 // depth
+    mask = (1 << depth) - 1
+    return [(row[i // per_byte] >> (8 - depth * (i % per_byte + 1))) & mask for i in range(count)]
+
+
+def read_png(path):
+    with open(path, "rb") as f:
+        data = f.read()
+
+    header = None
+    palette = None
+    transparency = b""
+    idat = b""
+    for kind, body in _chunks(data):
+        if kind == b"IHDR":
+            header = struct.unpack(">IIBBBBB", body)
+        elif kind == b"PLTE":
+            palette = [tuple(body[i:i + 3]) for i in range(0, len(body), 3)]
+        elif kind == b"tRNS":
+            transparency = body
+        elif kind == b"IDAT":
+            idat += body
+
+    width, height, depth, colour_type, _, _, interlace = header
+    if interlace:
+        raise ValueError("%s: interlaced PNGs are not supported" % path)
+
+    channels = CHANNELS[colour_type]
+    stride = (width * channels * depth + 7) // 8
+    bpp = max(1, channels * depth // 8)
+    rows = _unfilter(zlib.decompress(idat), height, stride, bpp)
+    scale = 255 // ((1 << depth) - 1) if depth < 8 else 1
+
+    if colour_type == PALETTE:
+        alpha = list(transparency) + [255] * (len(palette) - len(transparency))
+        rgba = [palette[i] + (alpha[i],) for i in range(len(palette))]
+        return Image(width, height, [_samples(row, width, depth) for row in rows], rgba)
+
+    pixels = []
+    for row in rows:
+        values = _samples(row, width * channels, depth)
+        line = []
+        for x in range(width):
+            px = values[x * channels:(x + 1) * channels]
+            if colour_type == GREYSCALE:
+                line.append((px[0] * scale,) * 3 + (255,))
+            elif colour_type == GREYSCALE_ALPHA:
+                line.append((px[0],) * 3 + (px[1],))
+            elif colour_type == TRUECOLOR:
+                line.append(tuple(px) + (255,))
+            else:
+                line.append(tuple(px))
+        pixels.append(line)
+    return Image(width, height, pixels)
+
+
+def _chunk(kind, body):
+    return struct.pack(">I", len(body)) + kind + body + struct.pack(">I", zlib.crc32(kind + body) & 0xFFFFFFFF)
+
+
+def write_png(path, image):
+    if image.palette is not None:
+        colour_type = PALETTE
+        rows = [bytes(row) for row in image.pixels]
+    else:
+        colour_type = TRUECOLOR_ALPHA
+        rows = [bytes(channel for px in row for channel in px) for row in image.pixels]
+
+    out = PNG_SIGNATURE
+    out += _chunk(b"IHDR", struct.pack(">IIBBBBB", image.width, image.height, 8, colour_type, 0, 0, 0))
+    if image.palette is not None:
+        out += _chunk(b"PLTE", b"".join(bytes(c[:3]) for c in image.palette))
+        out += _chunk(b"tRNS", bytes(c[3] for c in image.palette))
+    out += _chunk(b"IDAT", zlib.compress(b"".join(b"\x00" + row for row in rows), 9))
+    out += _chunk(b"IEND", b"")
+    with open(path, "wb") as f:
+        f.write(out)
+
+
+def pack(images):
+    width, height = images[0].width, images[0].height
+    for image in images:
+        if (image.width, image.height) != (width, height):
+            raise ValueError("atlas sources must all be %dx%d" % (width, height))
+
+    if all(image.palette is not None for image in images):
+        palette = []
+        for image in images:
+            for colour in image.palette:
+                if colour not in palette:
+                    palette.append(colour)
+        if len(palette) <= 256:
+            rows = [[] for _ in range(height)]
+            for image in images:
+                remap = [palette.index(colour) for colour in image.palette]
+                for y in range(height):
+                    rows[y].extend(remap[i] for i in image.pixels[y])
+            return Image(width * len(images), height, rows, palette)
+
+    rows = [[] for _ in range(height)]
+    for image in images:
+        for y in range(height):
+            if image.palette is not None:
+                rows[y].extend(image.palette[i] for i in image.pixels[y])
+            else:
+                rows[y].extend(image.pixels[y])
+    return Image(width * len(images), height, rows)
+
+
+def pack_atlas(output, sources):
+    write_png(output, pack([read_png(source) for source in sources]))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 3:
+        sys.exit(__doc__.strip().splitlines()[-1].strip())
+    pack_atlas(sys.argv[1], sys.argv[2:])